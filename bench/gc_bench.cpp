@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gc/gc.h"
+
+using namespace X;
+
+struct Object {
+    Object *next;
+    int64_t value;
+};
+
+struct TreeNode {
+    TreeNode *left;
+    TreeNode *right;
+    int64_t value;
+};
+
+// same layout as x arrays
+struct Array {
+    void **data;
+    int64_t len;
+    int64_t cap;
+};
+
+static void bench(const std::string &name, std::size_t ops, const std::function<void()> &fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << name << ": " << elapsed * 1000 << " ms, " << ops / elapsed / 1'000'000 << " Mops/s" << std::endl;
+}
+
+// most objects die young, a few of them are kept in roots
+static void allocSmall(std::size_t count) {
+    GC::GC gc;
+    auto meta = gc.addMeta(GC::NodeType::CLASS, {});
+    std::vector<void *> roots(1024);
+
+    for (auto &root: roots) {
+        gc.addGlobalRoot(&root, meta);
+    }
+
+    bench("alloc 16 bytes", count, [&]() {
+        for (std::size_t i = 0; i < count; i++) {
+            roots[i % roots.size()] = gc.alloc(sizeof(Object), meta);
+        }
+    });
+}
+
+static void allocMixed(std::size_t count) {
+    GC::GC gc;
+    auto meta = gc.addMeta(GC::NodeType::CLASS, {});
+    std::vector<void *> roots(1024);
+
+    for (auto &root: roots) {
+        gc.addGlobalRoot(&root, meta);
+    }
+
+    bench("alloc 16..512 bytes", count, [&]() {
+        for (std::size_t i = 0; i < count; i++) {
+            roots[i % roots.size()] = gc.alloc(16 + (i * 7919) % 497, meta);
+        }
+    });
+}
+
+// linked lists are kept alive, so collection has to trace them
+static void allocLists(std::size_t count) {
+    GC::GC gc;
+    auto meta = gc.addMeta(GC::NodeType::CLASS, {});
+    meta->pointerList.emplace_back(offsetof(Object, next), meta);
+    std::vector<Object *> heads(64);
+
+    for (auto &head: heads) {
+        gc.addGlobalRoot((void **)&head, meta);
+    }
+
+    bench("alloc linked lists", count, [&]() {
+        for (std::size_t i = 0; i < count; i++) {
+            auto &head = heads[i % heads.size()];
+            auto obj = (Object *)gc.alloc(sizeof(Object), meta);
+            obj->next = i % 4096 == 0 ? nullptr : head;
+            obj->value = (int64_t)i;
+            head = obj;
+        }
+    });
+
+    bench("collect linked lists", count, [&]() {
+        gc.run();
+    });
+}
+
+// append to array buffer, doubling its capacity like x arrays do
+static void growArray(std::size_t count) {
+    GC::GC gc;
+    auto arrayMeta = gc.addMeta(GC::NodeType::ARRAY, {});
+    Array *array = nullptr;
+    gc.addGlobalRoot((void **)&array, arrayMeta);
+
+    array = (Array *)gc.alloc(sizeof(Array), arrayMeta);
+    array->cap = 1;
+    array->data = (void **)gc.alloc(sizeof(void *), nullptr);
+
+    bench("grow array buffer", count, [&]() {
+        for (std::size_t i = 0; i < count; i++) {
+            if (array->len == array->cap) {
+                array->cap *= 2;
+                auto data = (void **)gc.realloc(array->data, array->cap * sizeof(void *));
+                array->data = data;
+                gc.writeBarrier(array);
+            }
+            array->data[array->len++] = nullptr;
+        }
+    });
+}
+
+static void allocTree(GC::GC &gc, GC::Metadata *meta, int depth, TreeNode *&root) {
+    root = (TreeNode *)gc.alloc(sizeof(TreeNode), meta);
+    if (depth > 0) {
+        allocTree(gc, meta, depth - 1, root->left);
+        allocTree(gc, meta, depth - 1, root->right);
+    }
+}
+
+// arrays of trees, like []Foo where every Foo links to other objects.
+// objects are old right away, because unrooted parents of the tree which is being built can't be moved
+static void collectGraph(std::size_t count, std::size_t threads) {
+    static constexpr int TREE_DEPTH = 10;
+    static constexpr std::size_t TREES_PER_ARRAY = 64;
+
+    GC::Options options;
+    options.nurserySize = 0;
+    options.markThreads = threads;
+    GC::GC gc(options);
+    auto nodeMeta = gc.addMeta(GC::NodeType::CLASS, {});
+    nodeMeta->pointerList.emplace_back(offsetof(TreeNode, left), nodeMeta);
+    nodeMeta->pointerList.emplace_back(offsetof(TreeNode, right), nodeMeta);
+    auto arrayMeta = gc.addMeta(GC::NodeType::ARRAY, {{0, nodeMeta}});
+
+    auto nodesPerArray = TREES_PER_ARRAY * ((1 << (TREE_DEPTH + 1)) - 1);
+    std::vector<Array *> arrays(std::max(count / 10 / nodesPerArray, std::size_t(1)));
+
+    for (auto &array: arrays) {
+        gc.addGlobalRoot((void **)&array, arrayMeta);
+    }
+
+    for (auto &array: arrays) {
+        array = (Array *)gc.alloc(sizeof(Array), arrayMeta);
+        array->data = (void **)gc.alloc(TREES_PER_ARRAY * sizeof(void *), nullptr);
+        array->len = array->cap = TREES_PER_ARRAY;
+
+        for (std::size_t i = 0; i < TREES_PER_ARRAY; i++) {
+            allocTree(gc, nodeMeta, TREE_DEPTH, (TreeNode *&)array->data[i]);
+        }
+    }
+
+    bench("collect object graph (" + std::to_string(threads) + " threads)", arrays.size() * nodesPerArray, [&]() {
+        gc.run();
+    });
+}
+
+int main(int argc, char *argv[]) {
+    std::size_t count = argc > 1 ? std::stoull(argv[1]) : 10'000'000;
+
+    allocSmall(count);
+    allocMixed(count);
+    allocLists(count);
+    growArray(count * 10);
+
+    std::size_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (std::size_t threads = 1; threads < maxThreads; threads *= 2) {
+        collectGraph(count, threads);
+    }
+    collectGraph(count, maxThreads);
+
+    return 0;
+}
@@ -99,6 +99,9 @@ namespace X {
         const NodeKind kind;
 
     public:
+        // source line of statements and class members, 0 for other nodes
+        int line = 0;
+
         Node(NodeKind kind) : kind(kind) {}
         virtual ~Node() = default;
 
@@ -33,12 +33,12 @@ namespace X::Codegen {
         auto obj = node->obj->gen(*this);
         auto &propName = node->name;
         auto [type, ptr] = getProp(obj, node->obj->type, propName);
-        return builder.CreateLoad(mapType(type), ptr, propName);
+        return gcAddTempRoot(builder.CreateLoad(mapType(type), ptr, propName), type);
     }
 
     llvm::Value *Codegen::gen(FetchStaticPropNode *node) {
         auto [type, ptr] = getStaticProp(node->className, node->propName);
-        return builder.CreateLoad(mapType(type), ptr, node->propName);
+        return gcAddTempRoot(builder.CreateLoad(mapType(type), ptr, node->propName), type);
     }
 
     llvm::Value *Codegen::gen(MethodCallNode *node) {
@@ -49,11 +49,11 @@ namespace X::Codegen {
             throw MethodNotFoundException(getClassName(node->obj->type), methodName);
         }
 
-        return callMethod(obj, node->obj->type, methodName, node->args);
+        return gcAddTempRoot(callMethod(obj, node->obj->type, methodName, node->args), node->type);
     }
 
     llvm::Value *Codegen::gen(StaticMethodCallNode *node) {
-        return callStaticMethod(node->className, node->methodName, node->args);
+        return gcAddTempRoot(callStaticMethod(node->className, node->methodName, node->args), node->type);
     }
 
     llvm::Value *Codegen::gen(AssignPropNode *node) {
@@ -67,6 +67,10 @@ namespace X::Codegen {
         value = castTo(value, node->expr->type, type);
         builder.CreateStore(value, ptr);
 
+        if (isObject(type)) {
+            gcWriteBarrier(obj);
+        }
+
         return nullptr;
     }
 
@@ -86,7 +90,7 @@ namespace X::Codegen {
             throw CodegenException("cannot instantiate abstract class " + node->name);
         }
 
-        auto obj = newObj(classDecl.llvmType);
+        auto obj = gcAddTempRoot(newObj(classDecl.llvmType, classDecl.type), classDecl.type);
 
         initVtable(obj, classDecl);
 
@@ -110,8 +114,6 @@ namespace X::Codegen {
         auto &interfaceDecl = interfaces[node->name];
 
         interfaceDecl.vtableType = genVtable(node, interfaceDecl);
-        // {vtable, obj ptr, gc meta}
-        interfaceDecl.llvmType->setBody({builder.getPtrTy(), builder.getPtrTy(), builder.getPtrTy()});
 
         return nullptr;
     }
@@ -181,7 +183,10 @@ namespace X::Codegen {
             case Type::TypeID::STRING:
                 return Runtime::String::CLASS_NAME;
             case Type::TypeID::ARRAY:
-                return Runtime::ArrayRuntime::getClassName(type);
+                // interface values are two words wide, so arrays of interfaces have their own runtime
+                return isInterfaceType(*type.getSubtype()) ?
+                       Runtime::ArrayRuntime::INTERFACE_CLASS_NAME :
+                       Runtime::ArrayRuntime::getClassName(type);
             default:
                 throw InvalidTypeException();
         }
@@ -206,18 +211,19 @@ namespace X::Codegen {
     GC::Metadata *Codegen::genTypeGCMeta(const Type &type) {
         switch (type.getTypeID()) {
             case Type::TypeID::STRING:
-                return gc->addMeta(GC::NodeType::CLASS, {});
+                // runtime allocates strings with the shared meta
+                return GC::GC::getStringMeta();
             case Type::TypeID::ARRAY: {
                 GC::PointerList pointerList;
                 auto containedMeta = getTypeGCMeta(*type.getSubtype());
                 if (containedMeta) {
                     pointerList.emplace_back(0, containedMeta);
                 }
-                return gc->addMeta(GC::NodeType::ARRAY, std::move(pointerList));
+                return gc->addMeta(GC::NodeType::ARRAY, std::move(pointerList), getTypeGCMetaKey(type));
             }
             case Type::TypeID::CLASS: {
                 if (isInterfaceType(type)) {
-                    return gc->addMeta(GC::NodeType::INTERFACE, {});
+                    return gc->addMeta(GC::NodeType::INTERFACE, {}, getTypeGCMetaKey(type));
                 }
 
                 auto &classDecl = getClassDecl(type.getClassName());
@@ -234,8 +240,14 @@ namespace X::Codegen {
                 return type.getClassName();
             case Type::TypeID::STRING:
                 return Runtime::String::CLASS_NAME;
-            case Type::TypeID::ARRAY:
-                return Runtime::ArrayRuntime::CLASS_NAME;
+            case Type::TypeID::ARRAY: {
+                // arrays of different element types have different pointer lists.
+                // scalar arrays are traced the same way, but they are named by element type for heap census
+                auto subtypeKey = getTypeGCMetaKey(*type.getSubtype());
+                return subtypeKey.empty() ?
+                       Runtime::ArrayRuntime::getClassName(type) :
+                       Runtime::ArrayRuntime::CLASS_NAME + "." + subtypeKey;
+            }
             default:
                 return "";
         }
@@ -243,7 +255,12 @@ namespace X::Codegen {
 
     llvm::Value *Codegen::getGCMetaValue(const Type &type) {
         auto meta = getTypeGCMeta(type);
-        return meta ? builder.CreateIntToPtr(builder.getInt64((uint64_t)meta), builder.getPtrTy()) : nullptr;
+        if (!meta) {
+            return nullptr;
+        }
+
+        // meta is linked by name, so the code doesn't depend on its address and could be cached
+        return module.getOrInsertGlobal(mangler->mangleGCMeta(meta->name), builder.getInt8Ty());
     }
 
     bool Codegen::isObject(const Type &type) const {
@@ -327,7 +344,7 @@ namespace X::Codegen {
         }
     }
 
-    void Codegen::initInterfaceVtable(llvm::Value *obj, const Type &objType, llvm::Value *interface, const InterfaceDecl &interfaceDecl) {
+    llvm::Constant *Codegen::getInterfaceVtable(const Type &objType, const InterfaceDecl &interfaceDecl) {
         auto &classDecl = getClassDecl(objType.getClassName());
         auto vtableName = fmt::format("{}.{}", interfaceDecl.vtableType->getName().str(), classDecl.name);
         auto vtable = llvm::cast<llvm::GlobalVariable>(module.getOrInsertGlobal(vtableName, interfaceDecl.vtableType));
@@ -348,8 +365,7 @@ namespace X::Codegen {
             vtable->setInitializer(llvm::ConstantStruct::get(interfaceDecl.vtableType, funcs));
         }
 
-        auto vtablePtr = builder.CreateStructGEP(interfaceDecl.llvmType, interface, 0);
-        builder.CreateStore(vtable, vtablePtr);
+        return vtable;
     }
 
     llvm::Function *Codegen::getInternalConstructor(const std::string &mangledClassName) const {
@@ -365,14 +381,17 @@ namespace X::Codegen {
         if (objType.is(Type::TypeID::CLASS)) {
             auto interfaceDecl = findInterfaceDecl(objType.getClassName());
             if (interfaceDecl) {
-                // get "this" from interface object
-                auto objPtr = builder.CreateStructGEP(interfaceDecl->llvmType, obj, 1);
-                obj = builder.CreateLoad(builder.getPtrTy(), objPtr);
+                // get "this" from interface value
+                // (it must be rooted by itself, because interface value could be a temporary)
+                obj = gcAddTempRoot(builder.CreateExtractValue(obj, 0), objType);
             }
         }
 
         std::vector<llvm::Value *> llvmArgs;
-        llvmArgs.reserve(args.size() + 1);
+        llvmArgs.reserve(args.size() + 2);
+        if (objType.is(Type::TypeID::STRING)) {
+            llvmArgs.push_back(getGCVar());
+        }
         llvmArgs.push_back(obj);
         for (auto i = 0; i < args.size(); i++) {
             auto val = args[i]->gen(*this);
@@ -380,7 +399,11 @@ namespace X::Codegen {
             llvmArgs.push_back(val);
         }
 
-        return builder.CreateCall(callee, llvmArgs);
+        auto res = builder.CreateCall(callee, llvmArgs);
+        // callee has changed alloc site
+        gcSetAllocSite();
+
+        return res;
     }
 
     llvm::Value *Codegen::callStaticMethod(const std::string &className, const std::string &methodName, const ExprList &args) {
@@ -398,7 +421,11 @@ namespace X::Codegen {
             llvmArgs.push_back(val);
         }
 
-        return builder.CreateCall(callee, llvmArgs);
+        auto res = builder.CreateCall(callee, llvmArgs);
+        // callee has changed alloc site
+        gcSetAllocSite();
+
+        return res;
     }
 
     std::tuple<llvm::FunctionCallee, FnType *> Codegen::findMethod(llvm::Value *obj, const Type &objType, const std::string &methodName) {
@@ -414,8 +441,7 @@ namespace X::Codegen {
             auto methodIt = interfaceDecl->methods.find(methodName);
             if (methodIt != interfaceDecl->methods.cend()) {
                 // get vtable
-                auto vtablePtr = builder.CreateStructGEP(interfaceDecl->llvmType, obj, 0);
-                auto vtable = builder.CreateLoad(builder.getPtrTy(), vtablePtr);
+                auto vtable = builder.CreateExtractValue(obj, 1);
                 // get method
                 auto methodPtr = builder.CreateStructGEP(interfaceDecl->vtableType, vtable, methodIt->second.vtablePos);
                 auto methodType = interfaceDecl->vtableType->getElementType(methodIt->second.vtablePos);
@@ -22,14 +22,23 @@ namespace X::Codegen {
     }
 
     llvm::Value *Codegen::gen(StatementListNode *node) {
+        auto outerLine = currentLine;
+
         for (auto child: node->children) {
+            currentLine = child->line;
+            gcSetAllocSite();
+
+            auto tempRootsMark = usedTempRoots.size();
             child->gen(*this);
+            gcReleaseTempRoots(tempRootsMark);
 
             if (child->isTerminate()) {
                 break;
             }
         }
 
+        currentLine = outerLine;
+
         return nullptr;
     }
 
@@ -62,7 +71,8 @@ namespace X::Codegen {
             case Type::TypeID::VOID:
                 return builder.getVoidTy();
             case Type::TypeID::CLASS: {
-                return builder.getPtrTy();
+                auto interfaceDecl = findInterfaceDecl(type.getClassName());
+                return interfaceDecl ? interfaceDecl->llvmType : builder.getPtrTy();
             }
             default:
                 throw InvalidTypeException();
@@ -79,8 +89,9 @@ namespace X::Codegen {
                 return builder.getFalse();
             case Type::TypeID::STRING:
             case Type::TypeID::ARRAY:
-            case Type::TypeID::CLASS:
                 return llvm::ConstantPointerNull::get(builder.getPtrTy());
+            case Type::TypeID::CLASS:
+                return llvm::Constant::getNullValue(mapType(type));
             default:
                 throw InvalidTypeException();
         }
@@ -95,14 +106,12 @@ namespace X::Codegen {
             case Type::TypeID::BOOL:
                 return builder.getFalse();
             case Type::TypeID::STRING:
-                return builder.CreateCall(module.getFunction(mangler->mangleInternalFunction("createEmptyString")));
-            case Type::TypeID::ARRAY: {
-                auto arrType = getArrayForType(type);
-                auto arr = newObj(arrType);
-                auto len = builder.getInt64(0);
-                builder.CreateCall(getInternalConstructor(arrType->getName().str()), {arr, len});
-                return arr;
-            }
+                gcSetAllocSite();
+                return gcAddTempRoot(builder.CreateCall(module.getFunction(mangler->mangleInternalFunction("createEmptyString")), {getGCVar()}), type);
+            case Type::TypeID::ARRAY:
+                return newArray(type, 0);
+            case Type::TypeID::CLASS:
+                return getDefaultValue(type);
             default:
                 throw InvalidTypeException();
         }
@@ -132,6 +141,17 @@ namespace X::Codegen {
         throw VarNotFoundException(name);
     }
 
+    bool Codegen::isLocalVar(const std::string &name) const {
+        // the first scope holds globals
+        for (auto i = varScopes.size(); i > 1; i--) {
+            if (varScopes[i - 1].contains(name)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
     llvm::AllocaInst *Codegen::createAlloca(llvm::Type *type, const std::string &name) const {
         auto fn = builder.GetInsertBlock()->getParent();
         llvm::IRBuilder<> tmpBuilder(&fn->getEntryBlock(), fn->getEntryBlock().begin());
@@ -139,9 +159,25 @@ namespace X::Codegen {
     }
 
     // allocates object on heap
-    llvm::Value *Codegen::newObj(llvm::StructType *type) {
-        auto allocSize = getTypeSize(module, type);
-        return gcAlloc(allocSize);
+    llvm::Value *Codegen::newObj(llvm::StructType *llvmType, const Type &type) {
+        auto allocSize = getTypeSize(module, llvmType);
+        return gcAlloc(allocSize, getGCMetaValue(type));
+    }
+
+    // allocates array and calls its constructor, elements of small arrays are allocated in the same cell
+    llvm::Value *Codegen::newArray(const Type &type, uint64_t len) {
+        auto arrType = getArrayForType(type);
+        auto headerSize = getTypeSize(module, arrType)->getZExtValue();
+        auto elemSize = getTypeSize(module, mapType(*type.getSubtype()))->getZExtValue();
+        auto cap = std::max(len, (uint64_t)Runtime::ArrayRuntime::MIN_CAP);
+        auto allocSize = headerSize + cap * elemSize;
+        auto inlineCap = allocSize <= Runtime::ArrayRuntime::MAX_INLINE_SIZE ? cap : 0;
+
+        // root array before constructor, because constructor could allocate array data.
+        // constructor sets the whole header of inline array without allocations, so it needn't be zeroed
+        auto arr = gcAddTempRoot(gcAlloc(builder.getInt64(inlineCap ? allocSize : headerSize), getGCMetaValue(type), !inlineCap), type);
+        builder.CreateCall(getInternalConstructor(arrType->getName().str()), {arr, builder.getInt64(len), builder.getInt64(inlineCap)});
+        return arr;
     }
 
     std::tuple<llvm::Value *, Type, llvm::Value *, Type> Codegen::upcast(llvm::Value *a, Type aType, llvm::Value *b, Type bType) const {
@@ -181,11 +217,11 @@ namespace X::Codegen {
             case Type::TypeID::STRING: {
                 const auto &stringIsEmptyFnName = mangler->mangleInternalMethod(Runtime::String::CLASS_NAME, "isEmpty");
                 auto stringIsEmptyFn = module.getFunction(stringIsEmptyFnName);
-                auto val = builder.CreateCall(stringIsEmptyFn, {value});
+                auto val = builder.CreateCall(stringIsEmptyFn, {getGCVar(), value});
                 return negate(val);
             }
             case Type::TypeID::ARRAY: {
-                const auto &arrayClassName = Runtime::ArrayRuntime::getClassName(type);
+                const auto &arrayClassName = getClassName(type);
                 const auto &arrayIsEmptyFnName = mangler->mangleInternalMethod(arrayClassName, "isEmpty");
                 auto arrayIsEmptyFn = module.getFunction(arrayIsEmptyFnName);
                 auto val = builder.CreateCall(arrayIsEmptyFn, {value});
@@ -226,21 +262,11 @@ namespace X::Codegen {
         return value;
     }
 
+    // interface value is {obj ptr, vtable}, so conversion doesn't allocate
     llvm::Value *Codegen::instantiateInterface(llvm::Value *value, const Type &type, const InterfaceDecl &interfaceDecl) {
-        auto interface = newObj(interfaceDecl.llvmType);
-
-        initInterfaceVtable(value, type, interface, interfaceDecl);
-
-        // set obj ptr
-        auto objPtr = builder.CreateStructGEP(interfaceDecl.llvmType, interface, 1);
-        builder.CreateStore(value, objPtr);
-
-        // set gc meta
-        auto meta = getGCMetaValue(type);
-        auto metaPtr = builder.CreateStructGEP(interfaceDecl.llvmType, interface, 2);
-        builder.CreateStore(meta, metaPtr);
-
-        return interface;
+        llvm::Value *interface = llvm::PoisonValue::get(interfaceDecl.llvmType);
+        interface = builder.CreateInsertValue(interface, value, 0);
+        return builder.CreateInsertValue(interface, getInterfaceVtable(type, interfaceDecl), 1);
     }
 
     llvm::Value *Codegen::compareStrings(llvm::Value *first, llvm::Value *second) const {
@@ -263,17 +289,17 @@ namespace X::Codegen {
             throw CodegenException("multidimensional arrays are not supported");
         }
 
-        const auto &arrayClassName = Runtime::ArrayRuntime::getClassName(arrType);
+        const auto &arrayClassName = getClassName(arrType);
         auto arrayType = llvm::StructType::getTypeByName(context, arrayClassName);
         if (!arrayType) {
             // gen array subtype
-            return arrayRuntime->add(arrType, mapType(subtype));
+            return arrayRuntime->add(arrayClassName, mapType(subtype));
         }
         return arrayType;
     }
 
     void Codegen::fillArray(llvm::Value *arr, const Type &type, const std::vector<llvm::Value *> &values) {
-        const auto &arrayClassName = Runtime::ArrayRuntime::getClassName(type);
+        const auto &arrayClassName = getClassName(type);
         auto arrSetFn = module.getFunction(mangler->mangleInternalMethod(arrayClassName, "set[]"));
         if (!arrSetFn) {
             throw InvalidArrayAccessException();
@@ -282,6 +308,10 @@ namespace X::Codegen {
         for (auto i = 0; i < values.size(); i++) {
             builder.CreateCall(arrSetFn, {arr, builder.getInt64(i), values[i]});
         }
+
+        if (!values.empty() && isObject(*type.getSubtype())) {
+            gcWriteBarrier(arr);
+        }
     }
 
     void Codegen::addSymbol(const std::string &symbol) {
@@ -76,6 +76,7 @@ namespace X::Codegen {
     struct InterfaceDecl {
         std::string name;
         Type type;
+        // interface values are passed by value as {obj ptr, vtable}
         llvm::StructType *llvmType;
         std::unordered_map<std::string, Method> methods;
         llvm::StructType *vtableType = nullptr;
@@ -92,6 +93,10 @@ namespace X::Codegen {
 
         std::deque<std::unordered_map<std::string, Value>> varScopes;
         std::stack<Loop> loops;
+        // temp gc roots of the current function. when the statement which filled a slot ends,
+        // the slot is reused for values of the same llvm type (interface values are bigger than pointers)
+        std::unordered_map<llvm::Type *, std::vector<llvm::AllocaInst *>> freeTempRoots;
+        std::vector<llvm::AllocaInst *> usedTempRoots;
 
         Type currentFnRetType;
         std::optional<Value> that;
@@ -101,6 +106,8 @@ namespace X::Codegen {
         std::unordered_set<std::string> symbols;
 
         std::unordered_map<std::string, GC::Metadata *> gcMetaCache;
+        // line of the statement being generated, it's the allocation site of the profiler
+        int currentLine = 0;
 
     public:
         static inline const std::string MAIN_FN_NAME = "main";
@@ -168,6 +175,7 @@ namespace X::Codegen {
         /// differs from getDefaultValue because getDefaultValue returns constant and createDefaultValue can emit instructions
         llvm::Value *createDefaultValue(const Type &type);
         std::pair<Type, llvm::Value *> getVar(std::string &name);
+        bool isLocalVar(const std::string &name) const;
         std::pair<const Type &, llvm::Value *> getProp(llvm::Value *obj, const Type &objType, const std::string &name);
         std::pair<const Type &, llvm::Value *> getStaticProp(const std::string &className, const std::string &propName) const;
         const ClassDecl &getClassDecl(const std::string &name) const;
@@ -185,11 +193,12 @@ namespace X::Codegen {
         void checkConstructor(MethodDefNode *node, const std::string &className) const;
         llvm::Value *callMethod(llvm::Value *obj, const Type &objType, const std::string &methodName, const ExprList &args);
         llvm::Value *callStaticMethod(const std::string &className, const std::string &methodName, const ExprList &args);
-        llvm::Value *newObj(llvm::StructType *type);
+        llvm::Value *newObj(llvm::StructType *llvmType, const Type &type);
+        llvm::Value *newArray(const Type &type, uint64_t len);
         llvm::StructType *genVtable(ClassNode *classNode, ClassDecl &classDecl);
         llvm::StructType *genVtable(InterfaceNode *classNode, InterfaceDecl &interfaceDecl);
         void initVtable(llvm::Value *obj, const ClassDecl &classDecl);
-        void initInterfaceVtable(llvm::Value *obj, const Type &objType, llvm::Value *interface, const InterfaceDecl &interfaceDecl);
+        llvm::Constant *getInterfaceVtable(const Type &objType, const InterfaceDecl &interfaceDecl);
 
         std::tuple<llvm::Value *, Type, llvm::Value *, Type> upcast(llvm::Value *a, Type aType, llvm::Value *b, Type bType) const;
         std::tuple<llvm::Value *, Type, llvm::Value *, Type> forceUpcast(llvm::Value *a, Type aType, llvm::Value *b, Type bType) const;
@@ -217,9 +226,17 @@ namespace X::Codegen {
         void addSymbol(const std::string &symbol);
 
         // gc helpers
-        llvm::Value *gcAlloc(llvm::Value *size);
+        llvm::Value *getGCVar() const;
+        std::string getGCStrategyName() const;
+        // memory which isn't zeroed must be initialized before the next allocation
+        llvm::Value *gcAlloc(llvm::Value *size, llvm::Value *meta, bool zero = true);
+        void gcWriteBarrier(llvm::Value *obj);
         void gcAddRoot(llvm::AllocaInst *root, const Type &type);
+        llvm::Value *gcAddTempRoot(llvm::Value *value, const Type &type);
+        // nulls temp roots filled since mark, so they don't keep garbage alive, and releases them
+        void gcReleaseTempRoots(std::size_t mark);
         void gcAddGlobalRoot(llvm::Value *root, const Type &type);
+        void gcSetAllocSite();
     };
 
     class CodegenException : public std::exception {
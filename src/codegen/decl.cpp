@@ -6,14 +6,12 @@ namespace X::Codegen {
     void Codegen::declInterfaces(TopStatementListNode *node) {
         for (auto interfaceNode: node->interfaces) {
             addSymbol(interfaceNode->name);
-            const auto &mangledName = mangler->mangleInterface(interfaceNode->name);
-
-            auto interface = llvm::StructType::create(context, mangledName);
 
             interfaces[interfaceNode->name] = {
                     .name = interfaceNode->name,
                     .type = Type::klass(interfaceNode->name),
-                    .llvmType = interface,
+                    // all interfaces share the same literal type, so arrays of interfaces share the runtime
+                    .llvmType = llvm::StructType::get(context, {builder.getPtrTy(), builder.getPtrTy()}),
             };
         }
     }
@@ -33,6 +31,8 @@ namespace X::Codegen {
                     .type = Type::klass(klassNode->name),
                     .llvmType = klass,
                     .isAbstract = klassNode->abstract,
+                    // pointer list is filled in declProps, so props could reference any class
+                    .meta = gc->addMeta(GC::NodeType::CLASS, {}, klassNode->name),
             };
         }
     }
@@ -104,7 +104,7 @@ namespace X::Codegen {
                 }
             }
 
-            classDecl.meta = gc->addMeta(GC::NodeType::CLASS, std::move(pointerList));
+            classDecl.meta->pointerList = std::move(pointerList);
 
             if (classDecl.needInit) {
                 genClassInit(klassNode, classDecl);
@@ -163,9 +163,13 @@ namespace X::Codegen {
                 mangler->mangleInternalFunction(INIT_FN_NAME),
                 module
         );
+        initFn->setGC(getGCStrategyName());
         auto bb = llvm::BasicBlock::Create(context, "entry", initFn);
         builder.SetInsertPoint(bb);
 
+        freeTempRoots.clear();
+        usedTempRoots.clear();
+
         varScopes.emplace_back();
         auto &vars = varScopes.back();
 
@@ -204,6 +208,9 @@ namespace X::Codegen {
         auto llvmType = mapType(type);
         auto global = llvm::cast<llvm::GlobalVariable>(module.getOrInsertGlobal(name, llvmType));
 
+        currentLine = node->line;
+        gcSetAllocSite();
+
         auto value = node->expr ?
                      castTo(node->expr->gen(*this), node->expr->type, type) :
                      createDefaultValue(type);
@@ -228,6 +235,9 @@ namespace X::Codegen {
         auto mangledPropName = mangler->mangleStaticProp(mangledClassName, decl->name);
         auto global = llvm::cast<llvm::GlobalVariable>(module.getOrInsertGlobal(mangledPropName, llvmType));
 
+        currentLine = prop->line;
+        gcSetAllocSite();
+
         auto value = decl->expr ?
                      castTo(decl->expr->gen(*this), decl->expr->type, type) :
                      createDefaultValue(type);
@@ -252,6 +262,7 @@ namespace X::Codegen {
                 mangler->mangleHiddenMethod(mangledName, INIT_FN_NAME),
                 module
         );
+        initFn->setGC(getGCStrategyName());
         builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", initFn));
 
         auto initFnThis = initFn->getArg(0);
@@ -269,10 +280,16 @@ namespace X::Codegen {
 
             auto decl = prop->decl;
             auto &type = decl->type;
+            currentLine = prop->line;
+            gcSetAllocSite();
             auto value = castTo(decl->expr->gen(*this), decl->expr->type, type);
             auto ptr = builder.CreateStructGEP(classDecl.llvmType, initFnThis, classDecl.props.at(decl->name).pos);
 
             builder.CreateStore(value, ptr);
+
+            if (isObject(type)) {
+                gcWriteBarrier(initFnThis);
+            }
         }
 
         builder.CreateRetVoid();
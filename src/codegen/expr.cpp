@@ -18,10 +18,11 @@ namespace X::Codegen {
             case Type::TypeID::BOOL:
                 return builder.getInt1(std::get<bool>(value));
             case Type::TypeID::STRING: {
-                auto str = newObj(llvm::StructType::getTypeByName(context, Runtime::String::CLASS_NAME));
-                auto dataPtr = builder.CreateGlobalStringPtr(std::get<std::string>(value));
-                builder.CreateCall(getInternalConstructor(Runtime::String::CLASS_NAME), {str, dataPtr});
-                return str;
+                auto &str = std::get<std::string>(value);
+                auto dataPtr = builder.CreateGlobalStringPtr(str);
+                auto createStringFn = module.getFunction(mangler->mangleInternalFunction("createString"));
+                gcSetAllocSite();
+                return gcAddTempRoot(builder.CreateCall(createStringFn, {getGCVar(), dataPtr, builder.getInt64(str.size())}), type);
             }
             case Type::TypeID::ARRAY: {
                 auto &exprList = std::get<ExprList>(value);
@@ -30,10 +31,7 @@ namespace X::Codegen {
                 for (auto expr: exprList) {
                     arrayValues.push_back(expr->gen(*this));
                 }
-                auto arrType = getArrayForType(type);
-                auto arr = newObj(arrType);
-                auto len = builder.getInt64(exprList.size());
-                builder.CreateCall(getInternalConstructor(arrType->getName().str()), {arr, len});
+                auto arr = newArray(type, exprList.size());
                 fillArray(arr, type, arrayValues);
                 return arr;
             }
@@ -106,7 +104,7 @@ namespace X::Codegen {
                 case OpType::PLUS: {
                     const auto &stringConcatFnName = mangler->mangleInternalMethod(Runtime::String::CLASS_NAME, "concat");
                     auto stringConcatFn = module.getFunction(stringConcatFnName);
-                    return builder.CreateCall(stringConcatFn, {lhs, rhs});
+                    return gcAddTempRoot(builder.CreateCall(stringConcatFn, {getGCVar(), lhs, rhs}), node->type);
                 }
                 case OpType::EQUAL:
                     return compareStrings(lhs, rhs);
@@ -191,19 +189,21 @@ namespace X::Codegen {
         }
 
         auto [type, var] = getVar(node->name);
-        return builder.CreateLoad(mapType(type), var, node->name);
+        auto value = builder.CreateLoad(mapType(type), var, node->name);
+        // locals are roots themselves, but globals and props could be reassigned while value is still in use
+        return isLocalVar(node->name) ? value : gcAddTempRoot(value, type);
     }
 
     llvm::Value *Codegen::gen(FetchArrNode *node) {
         auto arr = node->arr->gen(*this);
         auto idx = node->idx->gen(*this);
 
-        auto arrGetFn = module.getFunction(mangler->mangleInternalMethod(Runtime::ArrayRuntime::getClassName(node->arr->type), "get[]"));
+        auto arrGetFn = module.getFunction(mangler->mangleInternalMethod(getClassName(node->arr->type), "get[]"));
         if (!arrGetFn) {
             throw InvalidArrayAccessException();
         }
 
-        return builder.CreateCall(arrGetFn, {arr, idx});
+        return gcAddTempRoot(builder.CreateCall(arrGetFn, {arr, idx}), node->type);
     }
 
     llvm::Value *Codegen::genLogicalAnd(BinaryNode *node) {
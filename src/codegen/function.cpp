@@ -25,13 +25,13 @@ namespace X::Codegen {
 
         if (that) {
             try {
-                return callMethod(that->value, that->type, name, args);
+                return gcAddTempRoot(callMethod(that->value, that->type, name, args), node->type);
             } catch (const MethodNotFoundException &e) {}
         }
 
         if (self) {
             try {
-                return callStaticMethod(self->name, name, args);
+                return gcAddTempRoot(callStaticMethod(self->name, name, args), node->type);
             } catch (const MethodNotFoundException &e) {}
         }
 
@@ -50,7 +50,11 @@ namespace X::Codegen {
             llvmArgs.push_back(val);
         }
 
-        return builder.CreateCall(fn, llvmArgs);
+        auto res = builder.CreateCall(fn, llvmArgs);
+        // callee has changed alloc site
+        gcSetAllocSite();
+
+        return gcAddTempRoot(res, node->type);
     }
 
     void Codegen::genFn(const std::string &name, const std::vector<ArgNode *> &args, const Type &returnType, StatementListNode *body,
@@ -63,7 +67,7 @@ namespace X::Codegen {
             auto fnType = genFnType(args, returnType, thisType);
             fn = llvm::Function::Create(fnType, llvm::Function::ExternalLinkage, name, module);
         }
-        fn->setGC("x");
+        fn->setGC(getGCStrategyName());
         if (thisType) {
             fn->getArg(0)->setName(THIS_KEYWORD);
         }
@@ -82,6 +86,9 @@ namespace X::Codegen {
             that = Value{fn->getArg(0), *thisType};
         }
 
+        freeTempRoots.clear();
+        usedTempRoots.clear();
+
         varScopes.emplace_back();
         auto &vars = varScopes.back();
 
@@ -3,11 +3,30 @@
 #include "utils.h"
 
 namespace X::Codegen {
-    llvm::Value *Codegen::gcAlloc(llvm::Value *size) {
-        auto allocFn = module.getFunction(mangler->mangleInternalFunction("gcAlloc"));
-        auto gcVar = module.getGlobalVariable(mangler->mangleInternalSymbol("gc"));
+    // runtime functions get address of the global which keeps gc pointer
+    llvm::Value *Codegen::getGCVar() const {
+        return module.getGlobalVariable(mangler->mangleInternalSymbol("gc"));
+    }
+
+    std::string Codegen::getGCStrategyName() const {
+        return gc->getOptions().stackMaps ? "x-statepoint" : "x";
+    }
+
+    llvm::Value *Codegen::gcAlloc(llvm::Value *size, llvm::Value *meta, bool zero) {
+        auto allocFn = module.getFunction(mangler->mangleInternalFunction(zero ? "gcAlloc" : "gcAllocUninitialized"));
+        auto gcVar = getGCVar();
+
+        gcSetAllocSite();
+
+        return builder.CreateCall(allocFn, {gcVar, size, meta});
+    }
 
-        return builder.CreateCall(allocFn, {gcVar, size});
+    // obj could become old while it's being initialized, so every store of a pointer to the heap object needs a barrier
+    void Codegen::gcWriteBarrier(llvm::Value *obj) {
+        auto writeBarrierFn = module.getFunction(mangler->mangleInternalFunction("gcWriteBarrier"));
+        auto gcVar = getGCVar();
+
+        builder.CreateCall(writeBarrierFn, {gcVar, obj});
     }
 
     void Codegen::gcAddRoot(llvm::AllocaInst *root, const Type &type) {
@@ -16,7 +35,55 @@ namespace X::Codegen {
             return;
         }
 
-        builder.CreateIntrinsic(llvm::Intrinsic::gcroot, {}, {root, meta});
+        // register root once in the entry block (not in the loop body for example),
+        // so slot must be nulled before gc could see it
+        auto fn = builder.GetInsertBlock()->getParent();
+        llvm::IRBuilder<> tmpBuilder(&fn->getEntryBlock(), fn->getEntryBlock().begin());
+        tmpBuilder.SetInsertPointPastAllocas(fn);
+        tmpBuilder.CreateStore(llvm::Constant::getNullValue(root->getAllocatedType()), root);
+        tmpBuilder.CreateIntrinsic(llvm::Intrinsic::gcroot, {}, {root, meta});
+    }
+
+    llvm::Value *Codegen::gcAddTempRoot(llvm::Value *value, const Type &type) {
+        if (!isObject(type)) {
+            return value;
+        }
+
+        if (!getGCMetaValue(type)) {
+            return value;
+        }
+
+        // gc could be triggered by any allocation, so intermediate values must be visible to it.
+        // marker takes meta from the cell, so slot could be reused for a value of another class, array or string
+        auto &freeRoots = freeTempRoots[value->getType()];
+        llvm::AllocaInst *root;
+        if (freeRoots.empty()) {
+            root = createAlloca(value->getType(), "tmp");
+            gcAddRoot(root, type);
+        } else {
+            root = freeRoots.back();
+            freeRoots.pop_back();
+        }
+
+        builder.CreateStore(value, root);
+        usedTempRoots.push_back(root);
+
+        return value;
+    }
+
+    void Codegen::gcReleaseTempRoots(std::size_t mark) {
+        // code after return, break and continue is unreachable
+        auto reachable = !builder.GetInsertBlock()->getTerminator();
+
+        for (auto i = mark; i < usedTempRoots.size(); i++) {
+            auto root = usedTempRoots[i];
+            if (reachable) {
+                builder.CreateStore(llvm::Constant::getNullValue(root->getAllocatedType()), root);
+            }
+            freeTempRoots[root->getAllocatedType()].push_back(root);
+        }
+
+        usedTempRoots.resize(mark);
     }
 
     void Codegen::gcAddGlobalRoot(llvm::Value *root, const Type &type) {
@@ -25,7 +92,18 @@ namespace X::Codegen {
             return;
         }
 
-        auto gcVar = module.getGlobalVariable(mangler->mangleInternalSymbol("gc"));
+        auto gcVar = getGCVar();
         builder.CreateCall(module.getFunction(mangler->mangleInternalFunction("gcAddGlobalRoot")), {gcVar, root, meta});
     }
+
+    // gc attributes allocations to the line stored in x.gcAllocSite. it's set by every statement
+    // and restored after calls, so allocations of the runtime functions are counted too
+    void Codegen::gcSetAllocSite() {
+        if (!gc->getOptions().profileAllocations) {
+            return;
+        }
+
+        auto allocSiteVar = module.getGlobalVariable(mangler->mangleInternalSymbol("gcAllocSite"));
+        builder.CreateStore(builder.getInt64(currentLine), allocSiteVar);
+    }
 }
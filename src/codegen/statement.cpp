@@ -32,6 +32,11 @@ namespace X::Codegen {
         value = castTo(value, node->expr->type, type);
         builder.CreateStore(value, var);
 
+        // var is a prop of this (locals are allocas, globals and static props are roots)
+        if (isObject(type) && that && !llvm::isa<llvm::AllocaInst>(var) && !llvm::isa<llvm::GlobalVariable>(var)) {
+            gcWriteBarrier(that->value);
+        }
+
         return nullptr;
     }
 
@@ -115,7 +120,7 @@ namespace X::Codegen {
         auto range = llvm::dyn_cast<RangeNode>(node->expr);
         auto expr = node->expr->gen(*this);
         auto exprType = node->expr->type;
-        auto arrTypeName = Runtime::ArrayRuntime::getClassName(exprType);
+        auto arrTypeName = getClassName(exprType);
 
         if (!range) {
             // add expr gc root
@@ -330,12 +335,16 @@ namespace X::Codegen {
         auto expr = node->expr->gen(*this);
         expr = castTo(expr, node->expr->type, *node->arr->type.getSubtype());
 
-        auto arrSetFn = module.getFunction(mangler->mangleInternalMethod(Runtime::ArrayRuntime::getClassName(node->arr->type), "set[]"));
+        auto arrSetFn = module.getFunction(mangler->mangleInternalMethod(getClassName(node->arr->type), "set[]"));
         if (!arrSetFn) {
             throw InvalidArrayAccessException();
         }
         builder.CreateCall(arrSetFn, {arr, idx, expr});
 
+        if (isObject(*node->arr->type.getSubtype())) {
+            gcWriteBarrier(arr);
+        }
+
         return nullptr;
     }
 
@@ -345,12 +354,15 @@ namespace X::Codegen {
         auto expr = node->expr->gen(*this);
         expr = castTo(expr, node->expr->type, *node->arr->type.getSubtype());
 
-        auto arrAppendFn = module.getFunction(mangler->mangleInternalMethod(Runtime::ArrayRuntime::getClassName(node->arr->type), "append[]"));
+        auto arrAppendFn = module.getFunction(mangler->mangleInternalMethod(getClassName(node->arr->type), "append[]"));
         if (!arrAppendFn) {
             throw InvalidArrayAccessException();
         }
         builder.CreateCall(arrAppendFn, {arr, expr});
 
+        // array data could be reallocated, so barrier is needed even for scalar arrays
+        gcWriteBarrier(arr);
+
         return nullptr;
     }
 }
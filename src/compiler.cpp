@@ -10,6 +10,7 @@
 #include "pipes/type_inferrer.h"
 #include "pipes/const_string_folding.h"
 #include "pipes/code_generator.h"
+#include "pipes/executable_emitter.h"
 
 namespace X {
     int Compiler::compile(const std::string &code, const std::string &sourceName) {
@@ -23,7 +24,22 @@ namespace X {
                 .pipe(Pipes::CheckVirtualMethods(compilerRuntime))
                 .pipe(Pipes::TypeInferrer(compilerRuntime))
                 .pipe(Pipes::ConstStringFolding())
-                .pipe(Pipes::CodeGenerator(compilerRuntime, sourceName));
+                .pipe(Pipes::CodeGenerator(compilerRuntime, sourceName, gcOptions, &gcStats, &gcCensus, cacheDir, jitOptions, &jitStats));
+
+        return 0;
+    }
+
+    int Compiler::build(const std::string &code, const std::string &sourceName, const std::string &outputFile) {
+        auto compilerRuntime = std::make_shared<CompilerRuntime>();
+
+        (Pipeline{})
+                .pipe(Pipes::ParseCode(code))
+                .pipe(Pipes::CheckInterfaces(compilerRuntime))
+                .pipe(Pipes::CheckAbstractClasses())
+                .pipe(Pipes::CheckVirtualMethods(compilerRuntime))
+                .pipe(Pipes::TypeInferrer(compilerRuntime))
+                .pipe(Pipes::ConstStringFolding())
+                .pipe(Pipes::ExecutableEmitter(compilerRuntime, sourceName, outputFile));
 
         return 0;
     }
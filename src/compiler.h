@@ -2,9 +2,32 @@
 
 #include <string>
 
+#include "jit_options.h"
+#include "gc/gc.h"
+
 namespace X {
     class Compiler {
+        GC::Options gcOptions;
+        GC::Stats gcStats;
+        GC::Census gcCensus;
+        // compiled objects are cached in this directory, empty string disables the cache
+        std::string cacheDir;
+        JITOptions jitOptions;
+        JITStats jitStats;
+
     public:
+        Compiler(GC::Options gcOptions = {}, std::string cacheDir = "", JITOptions jitOptions = {}) :
+                gcOptions(std::move(gcOptions)), cacheDir(std::move(cacheDir)), jitOptions(jitOptions) {}
+
         int compile(const std::string &code, const std::string &sourceName = "narnia");
+        // compiles the program into native executable, gc options and the cache aren't used
+        int build(const std::string &code, const std::string &sourceName, const std::string &outputFile);
+
+        // gc stats of the last compiled program
+        const GC::Stats &getGCStats() const { return gcStats; }
+        // heap census of the last compiled program (see GC::Options::census)
+        const GC::Census &getGCCensus() const { return gcCensus; }
+        // jit stats of the last compiled program
+        const JITStats &getJITStats() const { return jitStats; }
     };
 }
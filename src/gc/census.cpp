@@ -0,0 +1,23 @@
+#include "census.h"
+
+namespace X::GC {
+    void Census::toJSON(std::ostream &os) const {
+        os << "{\n";
+        os << "  \"liveBytes\": " << liveBytes << ",\n";
+
+        os << "  \"types\": [";
+        for (std::size_t i = 0; i < entries.size(); i++) {
+            auto &entry = entries[i];
+            os << (i ? ",\n" : "\n");
+            os << "    {\"name\": \"" << entry.name << "\", \"count\": " << entry.count << ", \"bytes\": " << entry.bytes << "}";
+        }
+        os << (entries.empty() ? "" : "\n  ") << "],\n";
+
+        os << "  \"retainingPath\": [";
+        for (std::size_t i = 0; i < retainingPath.size(); i++) {
+            os << (i ? ", " : "") << '"' << retainingPath[i] << '"';
+        }
+        os << "]\n";
+        os << "}\n";
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace X::GC {
+    // live objects grouped by type, it's taken at the full collection with the largest live heap
+    struct Census {
+        struct Entry {
+            std::string name;
+            std::size_t count = 0;
+            std::size_t bytes = 0;
+        };
+
+        // cells without meta (array data for example)
+        static inline const std::string RAW_NAME = "raw";
+        static inline const std::string GLOBAL_ROOT_NAME = "global";
+        static inline const std::string STACK_ROOT_NAME = "stack";
+
+        std::size_t liveBytes = 0;
+        // sorted by bytes
+        std::vector<Entry> entries;
+        // types from the root to the nearest live object of Options::censusPathType, empty if it wasn't found
+        std::vector<std::string> retainingPath;
+
+        void toJSON(std::ostream &os) const;
+    };
+}
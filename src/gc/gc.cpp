@@ -1,52 +1,117 @@
 #include "gc.h"
 
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
 #include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <variant>
 
 namespace X::GC {
-    Metadata *GC::addMeta(NodeType type, PointerList &&pointerList) {
-        auto meta = new Metadata{type, std::move(pointerList)};
+    // named like Runtime::String::CLASS_NAME, so jitted code refers to it as to the meta of string type
+    Metadata x_gcStringMeta{NodeType::CLASS, {}, "String"};
+
+    Metadata *GC::addMeta(NodeType type, PointerList &&pointerList, std::string name) {
+        auto meta = new Metadata{type, std::move(pointerList), std::move(name)};
         metaBag.push_back(meta);
+        if (!meta->name.empty()) {
+            namedMetas[meta->name] = meta;
+        }
         return meta;
     }
 
-    void *GC::alloc(std::size_t size) {
-        auto ptr = std::malloc(size);
+    void *GC::allocate(std::size_t size, Metadata *meta, bool zero) {
+        if (heap.getLiveBytes() + allocatedBytes >= collectionThreshold) {
+            run();
+        } else if (options.nurserySize && heap.getYoungSize() >= options.nurserySize) {
+            // minor collections run by the full ones are counted in their pauses
+            auto start = std::chrono::steady_clock::now();
+            minor();
+            stats.addPause(std::chrono::steady_clock::now() - start);
+        }
+
+        auto ptr = allocCell(size, meta, zero);
         if (!ptr) {
-            std::abort();
+            // the last chance to fit into the heap limit
+            run();
+            ptr = allocCell(size, meta, zero);
+            if (!ptr) {
+                throw OutOfMemoryException();
+            }
+        }
+
+        stats.allocatedBytes += size;
+
+        if (options.profileAllocations) {
+            stats.addAllocation(*allocSite, size);
         }
-        std::memset(ptr, 0, size);
 
-        allocs[ptr] = false;
+        updateInlineAllocation();
 
         return ptr;
     }
 
     void *GC::realloc(void *ptr, std::size_t newSize) {
-        auto newPtr = std::realloc(ptr, newSize);
-        if (!newPtr) {
-            std::abort();
+        auto oldSize = heap.getCellSize(ptr);
+        if (newSize <= oldSize) {
+            return ptr;
         }
 
-        if (newPtr != ptr) {
-            allocs.erase(ptr);
-            allocs[newPtr] = false;
+        if (auto newPtr = heap.growLarge(ptr, newSize)) {
+            allocatedBytes += newSize - oldSize;
+            stats.allocatedBytes += newSize - oldSize;
+
+            if (options.profileAllocations) {
+                stats.addAllocation(*allocSite, newSize - oldSize);
+            }
+
+            updateInlineAllocation();
+
+            return newPtr;
+        }
+
+        // old data must stay in place until it's copied
+        FixedStackFrame<1> frame;
+        frame.roots[0] = &ptr;
+        pushStackFrame(&frame.header);
+        auto newPtr = allocUninitialized(newSize, nullptr);
+        popStackFrame();
+
+        if (ptr) {
+            std::memcpy(newPtr, ptr, oldSize);
+            heap.free(ptr);
         }
 
         return newPtr;
     }
 
-    void GC::pushStackFrame() {
-        stackFrames.emplace_back();
+    void *GC::allocCell(std::size_t size, Metadata *meta, bool zero) {
+        if (options.nurserySize && size <= Heap::MAX_SMALL_SIZE) {
+            return heap.allocYoung(size, meta);
+        }
+
+        auto ptr = heap.alloc(size, meta, zero);
+        if (ptr) {
+            allocatedBytes += size;
+        }
+
+        return ptr;
     }
 
-    void GC::popStackFrame() {
-        stackFrames.pop_back();
+    AllocRegion *GC::getAllocRegion(std::size_t size) {
+        // profiler counts every allocation
+        if (!options.nurserySize || options.profileAllocations || size > Heap::MAX_SMALL_SIZE) {
+            return nullptr;
+        }
+
+        return heap.getAllocRegion(size);
     }
 
-    void GC::addRoot(void **root, Metadata *meta) {
-        stackFrames.back().push_back({root, meta});
+    void GC::updateInlineAllocation() {
+        auto collectionDue = heap.getLiveBytes() + allocatedBytes >= collectionThreshold ||
+                             (options.nurserySize && heap.getYoungSize() >= options.nurserySize);
+        heap.setInlineAllocation(!collectionDue && !options.profileAllocations);
     }
 
     void GC::addGlobalRoot(void **root, Metadata *meta) {
@@ -54,95 +119,316 @@ namespace X::GC {
     }
 
     void GC::run() {
+        auto start = std::chrono::steady_clock::now();
+
+        if (options.nurserySize) {
+            minor();
+        }
+
+        auto markStart = std::chrono::steady_clock::now();
         mark();
+        auto sweepStart = std::chrono::steady_clock::now();
         sweep();
+        auto compactStart = std::chrono::steady_clock::now();
+        if (options.compact) {
+            compact();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        allocatedBytes = 0;
+        collectionThreshold = std::max(options.threshold, (std::size_t)((double)heap.getLiveBytes() * options.heapGrowthFactor));
+
+        // everything allocated since the last collection is either live now or freed
+        auto liveBytes = heap.getLiveBytes();
+        auto heldBytes = stats.liveBytes + (stats.allocatedBytes - lastAllocatedBytes);
+        stats.freedBytes += heldBytes > liveBytes ? heldBytes - liveBytes : 0;
+        stats.liveBytes = liveBytes;
+        stats.maxLiveBytes = std::max(stats.maxLiveBytes, liveBytes);
+        lastAllocatedBytes = stats.allocatedBytes;
+
+        stats.collections++;
+        stats.markTime += sweepStart - markStart;
+        stats.sweepTime += compactStart - sweepStart;
+        stats.compactTime += end - compactStart;
+        stats.addPause(end - start);
+
+        // marks stay valid until the next collection, but new objects aren't marked
+        if (options.census) {
+            takeCensus();
+        }
     }
 
-    void GC::mark() {
-        for (auto &alloc: allocs) {
-            alloc.second = false;
+    Stats GC::getStats() const {
+        auto res = stats;
+        res.heapBytes = heap.getPagesBytes();
+        res.peakRssBytes = Stats::getPeakRss();
+        return res;
+    }
+
+    void GC::minor() {
+        auto start = std::chrono::steady_clock::now();
+
+        // survivors must be copied anyway, heap limit is checked by the next allocation
+        heap.setMaxSize(0);
+        std::vector<void *> worklist;
+
+        // values of stack slots could be kept in registers, so objects referenced from the stack can't be moved.
+        // their pages are promoted to old generation as a whole
+        forEachStackRoot([&](void **root) {
+            auto page = heap.findPage(*root);
+            if (page && page->young) {
+                page->pinned = true;
+            }
+        });
+
+        forEachStackRoot([&](void **root) {
+            evacuate(*root, worklist);
+        });
+
+        for (auto &root: globalRoots) {
+            *root.ptr = evacuate(*root.ptr, worklist);
+        }
+
+        for (auto obj: rememberedSet) {
+            heap.forget(obj);
+            scanYoung(obj, worklist);
+        }
+        rememberedSet.clear();
+
+        while (!worklist.empty()) {
+            auto ptr = worklist.back();
+            worklist.pop_back();
+
+            scanYoung(ptr, worklist);
+        }
+
+        heap.releaseYoungPages();
+        heap.setMaxSize(options.maxHeapSize);
+
+        stats.minorCollections++;
+        stats.minorTime += std::chrono::steady_clock::now() - start;
+    }
+
+    void *GC::evacuate(void *ptr, std::vector<void *> &worklist) {
+        auto page = heap.findPage(ptr);
+        if (!page || !page->young) {
+            return ptr;
+        }
+
+        if (page->pinned) {
+            if (heap.tryMark(ptr)) {
+                worklist.push_back(ptr);
+            }
+
+            return ptr;
+        }
+
+        // mark bit of young object means that it was already copied and first word keeps its new address
+        if (!heap.tryMark(ptr)) {
+            return *(void **)ptr;
+        }
+
+        auto meta = heap.getMeta(ptr);
+        auto copy = heap.alloc(page->cellSize, meta, false);
+        if (!copy) {
+            std::abort(); // system is out of memory
+        }
+
+        std::memcpy(copy, ptr, page->cellSize);
+
+        // inline array data moves together with the array
+        if (meta && meta->type == NodeType::ARRAY && hasInlineData(ptr)) {
+            ((ArrayHeader *)copy)->data = (char *)copy + sizeof(ArrayHeader);
         }
 
-        std::deque<std::pair<void *, Metadata *>> objects;
+        *(void **)ptr = copy;
+        allocatedBytes += page->cellSize;
+        stats.promotedBytes += page->cellSize;
+
+        worklist.push_back(copy);
+
+        return copy;
+    }
+
+    void GC::scanYoung(void *ptr, std::vector<void *> &worklist) {
+        auto meta = heap.getMeta(ptr);
+        if (!meta) {
+            return; // raw memory
+        }
+
+        forEachField(ptr, meta, [&](void **field) {
+            if (*field) {
+                *field = evacuate(*field, worklist);
+            }
+        });
+    }
+
+    void GC::mark() {
+        heap.clearMarks();
+
+        std::vector<void *> roots;
 
         for (auto &root: globalRoots) {
             if (*root.ptr) {
-                objects.emplace_back(*root.ptr, root.meta);
+                roots.push_back(*root.ptr);
             }
         }
 
-        for (auto &roots: stackFrames) {
-            for (auto &root: roots) {
-                if (*root.ptr) {
-                    objects.emplace_back(*root.ptr, root.meta);
-                }
+        forEachStackRoot([&](void **root) {
+            if (*root) {
+                roots.push_back(*root);
             }
-        }
+        });
 
-        while (!objects.empty()) {
-            auto [ptr, meta] = objects.back();
-            objects.pop_back();
+        // waking up marking threads costs more than marking of a small heap
+        marker.mark(roots, heap.getPagesCount() >= PARALLEL_MARK_MIN_PAGES);
+    }
 
-            auto it = allocs.find(ptr);
-            if (it == allocs.cend()) {
-                return; // some broken link (shouldn't happen)
-            }
+    void GC::sweep() {
+        if (options.lazySweep) {
+            heap.sweepLazily();
+        } else {
+            heap.sweep();
+        }
+    }
 
-            if (it->second) {
-                continue; // already visited this alloc
+    void GC::compact() {
+        // values of stack slots could be kept in registers, so objects referenced from the stack stay in place
+        forEachStackRoot([&](void **root) {
+            if (auto page = heap.findPage(*root)) {
+                page->pinned = true;
             }
+        });
 
-            it->second = true;
-
-            switch (meta->type) {
-                case NodeType::CLASS:
-                    for (auto [offset, fieldMeta]: meta->pointerList) {
-                        auto fieldPtr = (void **)((uint64_t)ptr + offset);
-                        if (*fieldPtr) {
-                            objects.emplace_back(*fieldPtr, fieldMeta);
-                        }
-                    }
-
-                    break;
-                case NodeType::INTERFACE: {
-                    auto objPtr = (void **)((uint64_t)ptr + sizeof(void *));
-                    auto metaPtr = (Metadata **)((uint64_t)ptr + 2 * sizeof(void *));
-                    objects.emplace_back(*objPtr, *metaPtr);
-                    break;
+        auto pages = heap.selectEvacuationPages();
+
+        // live objects must be copied anyway, heap limit is checked by the next allocation
+        heap.setMaxSize(0);
+
+        for (auto page: pages) {
+            Heap::forEachMarkedCell(*page, [&](void *ptr, std::size_t size, Metadata *meta) {
+                auto copy = heap.alloc(size, meta, false);
+                if (!copy) {
+                    std::abort(); // system is out of memory
                 }
-                case NodeType::ARRAY: {
-                    auto arr = *(void **)ptr;
-                    allocs[arr] = true;
 
-                    if (meta->pointerList.empty()) { // if it's scalar array, then there's no need to process
-                        break;
-                    }
+                std::memcpy(copy, ptr, size);
 
-                    auto lenPtr = (int64_t *)((uint64_t)ptr + sizeof(void *));
-                    auto len = *lenPtr;
+                // inline array data moves together with the array
+                if (meta && meta->type == NodeType::ARRAY && hasInlineData(ptr)) {
+                    ((ArrayHeader *)copy)->data = (char *)copy + sizeof(ArrayHeader);
+                }
 
-                    for (auto i = 0; i < len; i++) {
-                        auto elemPtr = (void **)((uint64_t)arr + i * sizeof(void *));
-                        if (*elemPtr) {
-                            objects.emplace_back(*elemPtr, meta->pointerList.front().second);
-                        }
-                    }
+                heap.tryMark(copy);
+                *(void **)ptr = copy;
+                stats.compactedBytes += size;
+            });
+        }
 
-                    break;
+        heap.setMaxSize(options.maxHeapSize);
+
+        if (!pages.empty()) {
+            auto forward = [&](void **field) {
+                auto page = heap.findPage(*field);
+                if (page && page->evacuated) {
+                    *field = *(void **)*field;
                 }
+            };
+
+            for (auto &root: globalRoots) {
+                forward(root.ptr);
             }
+
+            // marked cells of evacuated pages are skipped
+            heap.forEachMarkedCell([&](void *ptr, std::size_t, Metadata *meta) {
+                if (meta) {
+                    forEachField(ptr, meta, forward);
+                }
+            });
         }
+
+        heap.releaseEvacuatedPages();
     }
 
-    void GC::sweep() {
-        for (auto it = allocs.begin(); it != allocs.end();) {
-            if (it->second) {
-                it->second = false;
-                it++;
-            } else {
-                std::free(it->first);
-                it = allocs.erase(it);
+    void GC::takeCensus() {
+        if (heap.getLiveBytes() <= census.liveBytes) {
+            return;
+        }
+
+        std::unordered_map<Metadata *, Census::Entry> entries;
+        census.liveBytes = 0;
+
+        heap.forEachMarkedCell([&](void *, std::size_t size, Metadata *meta) {
+            auto &entry = entries[meta];
+            entry.count++;
+            entry.bytes += size;
+            census.liveBytes += size;
+        });
+
+        census.entries.clear();
+        for (auto &[meta, entry]: entries) {
+            entry.name = meta ? meta->name : Census::RAW_NAME;
+            census.entries.push_back(std::move(entry));
+        }
+        std::ranges::sort(census.entries, [](const Census::Entry &a, const Census::Entry &b) { return a.bytes > b.bytes; });
+
+        if (!options.censusPathType.empty()) {
+            census.retainingPath = findRetainingPath(options.censusPathType);
+        }
+    }
+
+    std::vector<std::string> GC::findRetainingPath(const std::string &typeName) {
+        // object -> the one which references it (roots are referenced by the name of their kind)
+        std::unordered_map<void *, std::variant<void *, const std::string *>> parents;
+        // breadth first search finds the shortest path
+        std::deque<void *> queue;
+
+        auto visit = [&](void *ptr, std::variant<void *, const std::string *> parent) {
+            if (heap.getCellSize(ptr) && parents.emplace(ptr, parent).second) {
+                queue.push_back(ptr);
+            }
+        };
+
+        for (auto &root: globalRoots) {
+            visit(*root.ptr, &Census::GLOBAL_ROOT_NAME);
+        }
+
+        forEachStackRoot([&](void **root) {
+            visit(*root, &Census::STACK_ROOT_NAME);
+        });
+
+        while (!queue.empty()) {
+            auto ptr = queue.front();
+            queue.pop_front();
+
+            auto meta = heap.getMeta(ptr);
+            if (!meta) {
+                continue; // raw memory
+            }
+
+            if (meta->name == typeName) {
+                std::vector<std::string> path;
+                auto parent = parents[ptr];
+                path.push_back(meta->name);
+
+                while (std::holds_alternative<void *>(parent)) {
+                    auto obj = std::get<void *>(parent);
+                    auto objMeta = heap.getMeta(obj);
+                    path.push_back(objMeta ? objMeta->name : Census::RAW_NAME);
+                    parent = parents[obj];
+                }
+
+                path.push_back(*std::get<const std::string *>(parent));
+                std::ranges::reverse(path);
+
+                return path;
             }
+
+            forEachField(ptr, meta, [&](void **field) {
+                visit(*field, ptr);
+            });
         }
+
+        return {};
     }
 }
@@ -1,59 +1,199 @@
 #pragma once
 
+#include <algorithm>
+#include <string>
+#include <thread>
 #include <unordered_map>
-#include <deque>
 #include <vector>
 
-namespace X::GC {
-    struct Metadata;
+#include "census.h"
+#include "heap.h"
+#include "marker.h"
+#include "metadata.h"
+#include "stack_map.h"
+#include "stats.h"
 
+namespace X::GC {
     struct Root {
         void **ptr;
         Metadata *meta;
     };
 
-    enum class NodeType {
-        CLASS,
-        INTERFACE,
-        ARRAY,
+    // frame of the shadow stack, it's allocated on the stack by the function which owns the roots.
+    // addresses of root slots follow the header (codegen emits frames of the same layout)
+    struct StackFrame {
+        StackFrame *prev;
+        int64_t rootsCount;
+
+        void ***getRoots() { return (void ***)(this + 1); }
     };
 
-    // pair<offset, meta>
-    using PointerList = std::vector<std::pair<unsigned long, Metadata *>>;
+    // shadow stack frame for native code
+    template<std::size_t N>
+    struct FixedStackFrame {
+        StackFrame header{nullptr, N};
+        void **roots[N];
+    };
 
-    struct Metadata {
-        NodeType type;
-        PointerList pointerList;
+    struct Options {
+        // initial heap size, full collection runs when old generation reaches max(threshold, heapGrowthFactor * live bytes)
+        std::size_t threshold = 64 * 1024 * 1024;
+        double heapGrowthFactor = 2;
+        // hard limit of the heap size, 0 means no limit
+        std::size_t maxHeapSize = 0;
+        // run minor collection when young generation reaches this size, 0 disables young generation
+        std::size_t nurserySize = 4 * 1024 * 1024;
+        // number of threads marking the heap in full collection (including the one which runs the collection)
+        std::size_t markThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        // build free lists during allocation instead of the collection pause
+        bool lazySweep = true;
+        // move live objects out of sparse pages at full collection, so the pages could be released
+        bool compact = false;
+        // find stack roots with stack maps of gc.statepoint calls instead of shadow stack frames.
+        // roots stay in stack slots (see XStatepointLowering), only the cost of linking frames is saved
+        bool stackMaps = false;
+        // take heap census at the full collection with the largest live heap
+        bool census = false;
+        // census looks for retaining path of the nearest live object of this type (meta name)
+        std::string censusPathType;
+        // count allocations per source line, which is stored by jitted code to x.gcAllocSite
+        bool profileAllocations = false;
     };
 
+    // strings are allocated by runtime and have no pointers, so every gc shares their meta.
+    // it has c linkage, because aot compiled code links to it (see Pipes::ExecutableEmitter)
+    extern "C" Metadata x_gcStringMeta;
+    inline const std::string STRING_META_SYMBOL = "x_gcStringMeta";
+
     class GC {
+        // 4MB
+        static constexpr std::size_t PARALLEL_MARK_MIN_PAGES = 64;
+
+        Options options;
         std::vector<Metadata *> metaBag;
+        // jitted code refers to metas by name (see Mangler::mangleGCMeta)
+        std::unordered_map<std::string, Metadata *> namedMetas;
 
-        // {ptr -> is alive}
-        std::unordered_map<void *, bool> allocs;
+        Heap heap;
+        Marker marker;
         std::vector<Root> globalRoots;
-        std::deque<std::vector<Root>> stackFrames;
+        // top of the shadow stack is kept by jitted code, own one is used before it's linked
+        StackFrame *ownStackTop = nullptr;
+        StackFrame **stackTop = &ownStackTop;
+        // source line of the current allocation site (see Options::profileAllocations)
+        int64_t ownAllocSite = 0;
+        const int64_t *allocSite = &ownAllocSite;
+        StackMap stackMap;
+        // frames below this address are walked for stack map roots
+        const void *stackBase = nullptr;
+        // old objects which could point to young ones
+        std::vector<void *> rememberedSet;
+        std::size_t allocatedBytes = 0;
+        // size of old generation which triggers full collection
+        std::size_t collectionThreshold;
+        Stats stats;
+        // stats.allocatedBytes at the end of the last full collection
+        std::size_t lastAllocatedBytes = 0;
+        Census census;
 
     public:
+        explicit GC(Options options = {}) : options(options), marker(heap, options.markThreads), collectionThreshold(options.threshold) {
+            heap.setMaxSize(options.maxHeapSize);
+            namedMetas[x_gcStringMeta.name] = &x_gcStringMeta;
+        }
+
         virtual ~GC() {
             for (auto meta: metaBag) {
                 delete meta;
             }
         }
 
-        Metadata *addMeta(NodeType type, PointerList &&pointerList);
+        const Options &getOptions() const { return options; }
+
+        Metadata *addMeta(NodeType type, PointerList &&pointerList, std::string name = "");
+        const std::unordered_map<std::string, Metadata *> &getNamedMetas() const { return namedMetas; }
+        // metas added to this gc (the shared string meta isn't one of them)
+        const std::vector<Metadata *> &getMetas() const { return metaBag; }
+        static Metadata *getStringMeta() { return &x_gcStringMeta; }
 
+        // full collection
         void run();
 
-        void *alloc(std::size_t size);
+        // meta is null for raw memory (like array data)
+        void *alloc(std::size_t size, Metadata *meta) { return allocate(size, meta, true); }
+        // memory isn't zeroed, so object must be initialized before the next allocation (raw memory is never scanned).
+        // it saves the memset when the caller overwrites the whole object anyway
+        void *allocUninitialized(std::size_t size, Metadata *meta) { return allocate(size, meta, false); }
+        // grows raw memory, new bytes aren't zeroed
         void *realloc(void *ptr, std::size_t newSize);
-        void pushStackFrame();
-        void popStackFrame();
-        void addRoot(void **root, Metadata *meta);
+        // jitted code allocates young objects of this size inline from this region and falls back to alloc when it's closed.
+        // returns nullptr if objects of this size can't be allocated inline
+        AllocRegion *getAllocRegion(std::size_t size);
+        // inline allocations add their size here
+        std::size_t *getAllocatedBytesCounter() { return &stats.allocatedBytes; }
+        // must be called after pointer is stored to obj
+        void writeBarrier(void *obj) {
+            if (heap.tryRemember(obj)) {
+                rememberedSet.push_back(obj);
+            }
+        }
+        void pushStackFrame(StackFrame *frame) {
+            frame->prev = *stackTop;
+            *stackTop = frame;
+        }
+        void popStackFrame() { *stackTop = (*stackTop)->prev; }
+        void setStackTop(StackFrame **top) {
+            *top = *stackTop;
+            stackTop = top;
+        }
         void addGlobalRoot(void **root, Metadata *meta);
+        void setAllocSite(const int64_t *site) { allocSite = site; }
+        // stats with current heap size and peak rss
+        Stats getStats() const;
+        const Census &getCensus() const { return census; }
+        void addStackMap(const uint8_t *data, std::size_t size) { stackMap.addSection(data, size); }
+        void setStackBase(const void *base) { stackBase = base; }
 
     private:
+        // calls fn for every stack root slot
+        template<typename F>
+        void forEachStackRoot(F &&fn) {
+            for (auto frame = *stackTop; frame; frame = frame->prev) {
+                auto roots = frame->getRoots();
+                for (int64_t i = 0; i < frame->rootsCount; i++) {
+                    fn(roots[i]);
+                }
+            }
+
+            if (stackBase && !stackMap.empty()) {
+                stackMap.forEachRoot(stackBase, fn);
+            }
+        }
+
+        void *allocate(std::size_t size, Metadata *meta, bool zero);
+        // returns nullptr if heap reached its max size
+        void *allocCell(std::size_t size, Metadata *meta, bool zero);
+        // jitted code can't check if collection is due, so young regions are open only while it's not
+        void updateInlineAllocation();
+
+        void minor();
+        // copies young object to old generation
+        void *evacuate(void *ptr, std::vector<void *> &worklist);
+        void scanYoung(void *ptr, std::vector<void *> &worklist);
+
         void mark();
         void sweep();
+        // must be called between sweeping and the next allocation, when young generation is empty
+        void compact();
+        // must be called between marking and the next allocation
+        void takeCensus();
+        std::vector<std::string> findRetainingPath(const std::string &typeName);
+    };
+
+    class OutOfMemoryException : public std::exception {
+    public:
+        const char *what() const noexcept override {
+            return "out of memory";
+        }
     };
 }
@@ -0,0 +1,479 @@
+#include "heap.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/mman.h>
+
+namespace X::GC {
+    void PageTable::set(const void *ptr, Page *page) {
+        auto pageNumber = (uintptr_t)ptr >> PAGE_BITS;
+        if (pageNumber >> (2 * LEAF_BITS)) {
+            std::abort(); // address is out of supported address space
+        }
+
+        auto &leaf = leaves[pageNumber >> LEAF_BITS];
+        if (!leaf) {
+            leaf = std::make_unique<Leaf>();
+            leaf->fill(nullptr);
+        }
+
+        (*leaf)[pageNumber & ((1 << LEAF_BITS) - 1)] = page;
+    }
+
+    Heap::Heap() {
+        for (std::size_t i = 0; i < SIZE_CLASSES.size(); i++) {
+            sizeClasses[i].cellSize = SIZE_CLASSES[i];
+            sizeClasses[i].young.cellSize = SIZE_CLASSES[i];
+
+            cellStarts[i].fill(0);
+            for (std::size_t offset = 0; offset + SIZE_CLASSES[i] <= PAGE_SIZE; offset += SIZE_CLASSES[i]) {
+                auto granule = offset / CELL_ALIGNMENT;
+                cellStarts[i][granule / 64] |= uint64_t(1) << (granule % 64);
+            }
+        }
+
+        // size (in CELL_ALIGNMENT units) -> smallest size class which fits it
+        std::size_t sizeClass = 0;
+        for (std::size_t i = 0; i < sizeClassIndex.size(); i++) {
+            while (SIZE_CLASSES[sizeClass] < i * CELL_ALIGNMENT) {
+                sizeClass++;
+            }
+            sizeClassIndex[i] = sizeClass;
+        }
+    }
+
+    Heap::~Heap() {
+        for (auto &page: pages) {
+            if (page->mapped) {
+                munmap(page->start, page->size);
+            } else {
+                std::free(page->start);
+            }
+        }
+
+        for (auto start: cachedPages) {
+            std::free(start);
+        }
+    }
+
+    void Heap::free(void *ptr) {
+        auto page = pageTable.find(ptr);
+        if (!page || page->isLarge() || page->young) {
+            return; // large objects are released by sweep, young ones by minor collection
+        }
+
+        auto cell = (FreeCell *)ptr;
+        auto &sizeClass = sizeClasses[page->sizeClass];
+        cell->next = sizeClass.freeList;
+        sizeClass.freeList = cell;
+    }
+
+    void *Heap::growLarge(void *ptr, std::size_t newSize) {
+#ifdef __linux__
+        auto page = pageTable.find(ptr);
+        // remembered set keeps objects by address
+        if (!page || !page->mapped || page->start != ptr || page->remembered[0]) {
+            return nullptr;
+        }
+
+        auto spanSize = (newSize + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+        if (!canGrow(spanSize - page->size)) {
+            return nullptr;
+        }
+
+        // kernel moves page table entries, the data itself is not copied
+        auto start = (char *)mremap(page->start, page->size, spanSize, 0);
+        if (start == MAP_FAILED) {
+            // can't grow in place, so pages are moved to the new aligned range
+            auto target = mapPages(spanSize);
+            if (!target) {
+                return nullptr;
+            }
+
+            start = (char *)mremap(page->start, page->size, spanSize, MREMAP_MAYMOVE | MREMAP_FIXED, target);
+            if (start == MAP_FAILED) {
+                munmap(target, spanSize);
+                return nullptr;
+            }
+        }
+
+        for (std::size_t offset = 0; offset < page->size; offset += PAGE_SIZE) {
+            pageTable.set(page->start + offset, nullptr);
+        }
+
+        pagesBytes += spanSize - page->size;
+        page->start = start;
+        page->size = page->cellSize = spanSize;
+
+        for (std::size_t offset = 0; offset < page->size; offset += PAGE_SIZE) {
+            pageTable.set(page->start + offset, page);
+        }
+
+        return start;
+#else
+        return nullptr;
+#endif
+    }
+
+    std::size_t Heap::getCellSize(const void *ptr) const {
+        auto page = pageTable.find(ptr);
+        if (!page || page->getBitPos(ptr).first == Page::NO_WORD) {
+            return 0;
+        }
+
+        return page->cellSize;
+    }
+
+    void Heap::forget(const void *ptr) {
+        auto page = pageTable.find(ptr);
+        auto [word, bit] = page->getBitPos(ptr);
+        page->remembered[word] &= ~bit;
+    }
+
+    void Heap::clearMarks() {
+        for (auto &page: pages) {
+            std::memset(page->marks.get(), 0, page->bitmapWords * sizeof(uint64_t));
+        }
+    }
+
+    void Heap::sweep() {
+        // free lists and bump regions are rebuilt from scratch
+        for (auto &sizeClass: sizeClasses) {
+            sizeClass.freeList = nullptr;
+            sizeClass.bump = sizeClass.bumpEnd = nullptr;
+            sizeClass.unsweptPages.clear();
+        }
+
+        liveBytes = 0;
+
+        std::erase_if(pages, [this](const std::unique_ptr<Page> &page) {
+            if (page->young) {
+                return false;
+            }
+
+            liveBytes += countLiveBytes(*page);
+            if (sweepPage(*page)) {
+                return false;
+            }
+
+            releasePage(*page);
+            return true;
+        });
+    }
+
+    void Heap::sweepLazily() {
+        for (auto &sizeClass: sizeClasses) {
+            sizeClass.freeList = nullptr;
+            sizeClass.bump = sizeClass.bumpEnd = nullptr;
+            sizeClass.unsweptPages.clear();
+        }
+
+        liveBytes = 0;
+
+        // checking mark bitmap is cheap, building free lists is what takes time (it touches every free cell)
+        std::erase_if(pages, [this](const std::unique_ptr<Page> &page) {
+            if (page->young) {
+                return false;
+            }
+
+            auto pageLiveBytes = countLiveBytes(*page);
+            liveBytes += pageLiveBytes;
+
+            if (!pageLiveBytes) {
+                releasePage(*page);
+                return true;
+            }
+
+            if (!page->isLarge()) {
+                sizeClasses[page->sizeClass].unsweptPages.push_back(page.get());
+            }
+
+            return false;
+        });
+    }
+
+    void Heap::setInlineAllocation(bool enabled) {
+        if (enabled == inlineAllocation) {
+            return;
+        }
+
+        inlineAllocation = enabled;
+        for (auto &sizeClass: sizeClasses) {
+            sizeClass.young.limit = enabled ? sizeClass.youngEnd : nullptr;
+        }
+    }
+
+    void Heap::releaseYoungPages() {
+        for (auto &sizeClass: sizeClasses) {
+            sizeClass.young.bump = sizeClass.young.limit = sizeClass.youngEnd = nullptr;
+            sizeClass.young.meta = nullptr;
+        }
+
+        std::erase_if(pages, [this](const std::unique_ptr<Page> &page) {
+            if (!page->young) {
+                return false;
+            }
+
+            if (!page->pinned) {
+                releasePage(*page);
+                return true;
+            }
+
+            // marks of pinned page tell which cells survived
+            page->young = false;
+            page->pinned = false;
+            sweepPage(*page);
+            std::memset(page->marks.get(), 0, page->bitmapWords * sizeof(uint64_t));
+            return false;
+        });
+
+        youngPagesCount = 0;
+    }
+
+    std::vector<Page *> Heap::selectEvacuationPages() {
+        std::array<std::vector<Page *>, SIZE_CLASSES.size()> sparsePages;
+        for (auto &page: pages) {
+            if (page->young || page->pinned || page->isLarge()) {
+                continue;
+            }
+
+            if ((double)countLiveBytes(*page) <= SPARSE_PAGE_LIVE_RATIO * (double)(page->cellCount * page->cellSize)) {
+                sparsePages[page->sizeClass].push_back(page.get());
+            }
+        }
+
+        std::vector<Page *> res;
+        for (std::size_t i = 0; i < sizeClasses.size(); i++) {
+            // objects of a single sparse page would just move to another page
+            if (sparsePages[i].size() < 2) {
+                continue;
+            }
+
+            for (auto page: sparsePages[i]) {
+                page->evacuated = true;
+                res.push_back(page);
+            }
+
+            auto &sizeClass = sizeClasses[i];
+            std::erase_if(sizeClass.unsweptPages, [](Page *page) { return page->evacuated; });
+
+            for (auto cell = &sizeClass.freeList; *cell;) {
+                if (pageTable.find(*cell)->evacuated) {
+                    *cell = (*cell)->next;
+                } else {
+                    cell = &(*cell)->next;
+                }
+            }
+        }
+
+        return res;
+    }
+
+    void Heap::releaseEvacuatedPages() {
+        std::erase_if(pages, [this](const std::unique_ptr<Page> &page) {
+            page->pinned = false;
+            if (!page->evacuated) {
+                return false;
+            }
+
+            releasePage(*page);
+            return true;
+        });
+    }
+
+    bool Heap::hasMarks(const Page &page) {
+        uint64_t live = 0;
+        for (std::size_t i = 0; i < page.bitmapWords; i++) {
+            live |= page.marks[i];
+        }
+
+        return live;
+    }
+
+    std::size_t Heap::countLiveBytes(const Page &page) {
+        std::size_t cells = 0;
+        for (std::size_t i = 0; i < page.bitmapWords; i++) {
+            cells += std::popcount(page.marks[i]);
+        }
+
+        return cells * page.cellSize;
+    }
+
+    char *Heap::allocSlow(SizeClass &sizeClass, bool young, std::size_t zeroSize) {
+        // marks of unswept pages are still valid, since new objects are never allocated in them
+        while (!young && !sizeClass.unsweptPages.empty()) {
+            auto page = sizeClass.unsweptPages.back();
+            sizeClass.unsweptPages.pop_back();
+            sweepPage(*page);
+
+            if (sizeClass.freeList) {
+                auto cell = (char *)sizeClass.freeList;
+                sizeClass.freeList = sizeClass.freeList->next;
+                std::memset(cell, 0, zeroSize);
+                return cell;
+            }
+        }
+
+        auto sizeClassIdx = (int)(&sizeClass - sizeClasses.data());
+        // bump allocation relies on zeroed pages
+        auto start = allocPages(PAGE_SIZE, true);
+        if (!start) {
+            return nullptr;
+        }
+
+        auto page = addPage(start, PAGE_SIZE, sizeClass.cellSize, sizeClassIdx, young);
+        auto end = start + page->cellCount * page->cellSize;
+
+        if (young) {
+            sizeClass.young.bump = start + sizeClass.cellSize;
+            sizeClass.young.limit = inlineAllocation ? end : nullptr;
+            sizeClass.young.meta = page->metas.get() + 1;
+            sizeClass.youngEnd = end;
+            youngPagesCount++;
+        } else {
+            sizeClass.bump = start + sizeClass.cellSize;
+            sizeClass.bumpEnd = end;
+        }
+
+        return start;
+    }
+
+    void *Heap::allocLarge(std::size_t size, Metadata *meta, bool zero) {
+        auto spanSize = (size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+        auto start = allocPages(spanSize, zero);
+        if (!start) {
+            return nullptr;
+        }
+
+        auto page = addPage(start, spanSize, spanSize, Page::LARGE_SIZE_CLASS, false);
+        page->metas[0] = meta;
+
+        return start;
+    }
+
+    Page *Heap::addPage(char *start, std::size_t size, std::size_t cellSize, int sizeClass, bool young) {
+        auto isLarge = sizeClass == Page::LARGE_SIZE_CLASS;
+        auto cellCount = size / cellSize;
+        auto bitmapWords = isLarge ? 1 : BITMAP_WORDS;
+
+        auto page = new Page{
+                .start = start,
+                .size = size,
+                .cellSize = cellSize,
+                .cellCount = cellCount,
+                .sizeClass = sizeClass,
+                .young = young,
+                .bitmapWords = bitmapWords,
+                .cellStarts = isLarge ? &LARGE_CELL_STARTS : cellStarts[sizeClass].data(),
+                .marks = std::make_unique<uint64_t[]>(bitmapWords),
+                .remembered = std::make_unique<uint64_t[]>(bitmapWords),
+                .metas = std::make_unique<Metadata *[]>(cellCount),
+                .cellSizeReciprocal = isLarge ? 0 : ((uint64_t(1) << 32) + cellSize - 1) / cellSize,
+        };
+        page->mapped = isLarge && size >= MAPPED_MIN_SIZE;
+        pages.emplace_back(page);
+        pagesBytes += size;
+
+        for (std::size_t offset = 0; offset < size; offset += PAGE_SIZE) {
+            pageTable.set(start + offset, page);
+        }
+
+        return page;
+    }
+
+    void Heap::releasePage(Page &page) {
+        pagesBytes -= page.size;
+
+        for (std::size_t offset = 0; offset < page.size; offset += PAGE_SIZE) {
+            pageTable.set(page.start + offset, nullptr);
+        }
+
+        if (page.mapped) {
+            munmap(page.start, page.size);
+        } else if (!page.isLarge() && cachedPages.size() < MAX_CACHED_PAGES) {
+            cachedPages.push_back(page.start);
+        } else {
+            std::free(page.start);
+        }
+    }
+
+    bool Heap::sweepPage(Page &page) {
+        auto live = hasMarks(page);
+        if (!live || page.isLarge()) {
+            return live;
+        }
+
+        // free cells are cell starts without mark bit
+        FreeCell *head = nullptr;
+        FreeCell **tail = &head;
+        for (std::size_t i = 0; i < page.bitmapWords; i++) {
+            auto freeBits = page.cellStarts[i] & ~page.marks[i];
+            while (freeBits) {
+                auto granule = i * 64 + std::countr_zero(freeBits);
+                freeBits &= freeBits - 1;
+
+                auto cell = (FreeCell *)(page.start + granule * CELL_ALIGNMENT);
+                *tail = cell;
+                tail = &cell->next;
+            }
+        }
+
+        auto &sizeClass = sizeClasses[page.sizeClass];
+        *tail = sizeClass.freeList;
+        sizeClass.freeList = head;
+
+        return true;
+    }
+
+    char *Heap::allocPages(std::size_t size, bool zero) {
+        if (!canGrow(size)) {
+            return nullptr;
+        }
+
+        // fresh mappings are zeroed by the kernel
+        if (size >= MAPPED_MIN_SIZE) {
+            return mapPages(size);
+        }
+
+        char *start;
+        if (size == PAGE_SIZE && !cachedPages.empty()) {
+            start = cachedPages.back();
+            cachedPages.pop_back();
+        } else {
+            start = (char *)std::aligned_alloc(PAGE_SIZE, size);
+            if (!start) {
+                return nullptr;
+            }
+        }
+
+        // the whole page is zeroed at once instead of every cell it will hold
+        if (zero) {
+            std::memset(start, 0, size);
+        }
+
+        return start;
+    }
+
+    char *Heap::mapPages(std::size_t size) {
+        // mmap aligns to os pages only, so the range is over-allocated and trimmed
+        auto raw = (char *)mmap(nullptr, size + PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            return nullptr;
+        }
+
+        auto start = (char *)(((uintptr_t)raw + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+        auto end = raw + size + PAGE_SIZE;
+
+        if (start != raw) {
+            munmap(raw, start - raw);
+        }
+        if (start + size != end) {
+            munmap(start + size, end - start - size);
+        }
+
+        return start;
+    }
+}
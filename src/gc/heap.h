@@ -0,0 +1,350 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace X::GC {
+    struct Metadata;
+
+    // page of cells of the same size (or a single large object spanning several pages)
+    struct Page {
+        char *start;
+        std::size_t size;
+        std::size_t cellSize;
+        std::size_t cellCount;
+        int sizeClass; // LARGE_SIZE_CLASS for large objects
+        bool young;
+        // page with objects referenced from the stack, they can't be moved.
+        // young pinned page is promoted as a whole
+        bool pinned = false;
+        // live objects were moved out by compaction, first words of their cells keep new addresses
+        bool evacuated = false;
+        // large object which is mmapped directly, so it could be grown with mremap
+        bool mapped = false;
+        // bitmaps are indexed by address (one bit per CELL_ALIGNMENT bytes), not by cell number
+        std::size_t bitmapWords;
+        const uint64_t *cellStarts; // shared between pages of the same size class
+        std::unique_ptr<uint64_t[]> marks;
+        std::unique_ptr<uint64_t[]> remembered;
+        // cell number -> meta
+        std::unique_ptr<Metadata *[]> metas;
+        uint64_t cellSizeReciprocal;
+
+        static constexpr int LARGE_SIZE_CLASS = -1;
+
+        bool isLarge() const { return sizeClass == LARGE_SIZE_CLASS; }
+
+        // offsets are less than 2^16 (or 0 for large objects), so multiplication by reciprocal is exact division
+        std::size_t getCellIndex(const void *ptr) const {
+            return ((uint64_t)((const char *)ptr - start) * cellSizeReciprocal) >> 32;
+        }
+
+        // word of getBitPos for interior pointers
+        static constexpr std::size_t NO_WORD = -1;
+
+        // {bitmap word, bit} of the cell which starts at ptr, word is NO_WORD for interior pointers
+        std::pair<std::size_t, uint64_t> getBitPos(const void *ptr) const;
+    };
+
+    // young bump region of a size class. jitted code allocates from it inline while bump is below limit
+    // (limit is nullptr when allocations have to go through gc, see Heap::setInlineAllocation)
+    struct AllocRegion {
+        char *bump = nullptr;
+        char *limit = nullptr;
+        // meta slot of the cell at bump
+        Metadata **meta = nullptr;
+        std::size_t cellSize = 0;
+    };
+
+    // maps addresses to heap pages, so we can tell if some pointer belongs to the heap
+    class PageTable {
+        static constexpr std::size_t ADDRESS_BITS = 48;
+        static constexpr std::size_t PAGE_BITS = 16;
+        static constexpr std::size_t LEAF_BITS = (ADDRESS_BITS - PAGE_BITS) / 2;
+
+        using Leaf = std::array<Page *, 1 << LEAF_BITS>;
+
+        std::unique_ptr<std::unique_ptr<Leaf>[]> leaves = std::make_unique<std::unique_ptr<Leaf>[]>(1 << LEAF_BITS);
+
+    public:
+        Page *find(const void *ptr) const {
+            auto pageNumber = (uintptr_t)ptr >> PAGE_BITS;
+            if (pageNumber >> (2 * LEAF_BITS)) {
+                return nullptr;
+            }
+
+            auto &leaf = leaves[pageNumber >> LEAF_BITS];
+            return leaf ? (*leaf)[pageNumber & ((1 << LEAF_BITS) - 1)] : nullptr;
+        }
+
+        void set(const void *ptr, Page *page);
+    };
+
+    class Heap {
+        struct FreeCell {
+            FreeCell *next;
+        };
+
+        struct SizeClass {
+            std::size_t cellSize;
+            FreeCell *freeList = nullptr;
+            char *bump = nullptr;
+            char *bumpEnd = nullptr;
+            // young objects are only bump allocated
+            AllocRegion young;
+            char *youngEnd = nullptr;
+            // pages with live objects, their free cells are collected when free list runs out
+            std::vector<Page *> unsweptPages;
+        };
+
+    public:
+        static constexpr std::size_t PAGE_SIZE = 64 * 1024;
+        static constexpr std::size_t CELL_ALIGNMENT = 16;
+        static constexpr std::size_t MAX_SMALL_SIZE = 2048;
+        // 4 classes per power of two, so internal fragmentation is under 25%
+        static constexpr std::array<std::size_t, 24> SIZE_CLASSES{
+                16, 32, 48, 64, 80, 96, 112, 128,
+                160, 192, 224, 256, 320, 384, 448, 512,
+                640, 768, 896, 1024, 1280, 1536, 1792, 2048,
+        };
+        // empty pages kept for reuse instead of returning them to the system
+        static constexpr std::size_t MAX_CACHED_PAGES = 64;
+        // large objects of this size and bigger are mmapped (see Page::mapped)
+        static constexpr std::size_t MAPPED_MIN_SIZE = 256 * 1024;
+        static constexpr std::size_t BITMAP_WORDS = PAGE_SIZE / CELL_ALIGNMENT / 64;
+        // pages with this share of live bytes or less are evacuated by compaction
+        static constexpr double SPARSE_PAGE_LIVE_RATIO = 0.5;
+
+    private:
+        using Bitmap = std::array<uint64_t, BITMAP_WORDS>;
+
+        std::array<SizeClass, SIZE_CLASSES.size()> sizeClasses;
+        std::array<Bitmap, SIZE_CLASSES.size()> cellStarts;
+        // large object is a single cell
+        static constexpr uint64_t LARGE_CELL_STARTS = 1;
+        std::array<uint8_t, MAX_SMALL_SIZE / CELL_ALIGNMENT + 1> sizeClassIndex;
+        std::vector<std::unique_ptr<Page>> pages;
+        std::vector<char *> cachedPages;
+        PageTable pageTable;
+        std::size_t youngPagesCount = 0;
+        // size of all pages in use
+        std::size_t pagesBytes = 0;
+        // bytes of cells marked by the last collection
+        std::size_t liveBytes = 0;
+        // pages are not allocated beyond this size, 0 means no limit
+        std::size_t maxSize = 0;
+        // young regions are open for inline allocation
+        bool inlineAllocation = false;
+
+    public:
+        Heap();
+        Heap(const Heap &) = delete;
+        Heap &operator=(const Heap &) = delete;
+        ~Heap();
+
+        // allocates object in old generation, first size bytes are zeroed if zero is set.
+        // returns nullptr if heap can't grow
+        void *alloc(std::size_t size, Metadata *meta, bool zero = true) {
+            if (size > MAX_SMALL_SIZE) {
+                return allocLarge(size, meta, zero);
+            }
+
+            auto &sizeClass = getSizeClass(size);
+            char *cell;
+
+            if (sizeClass.freeList) {
+                // free cells keep old data, while bump regions are carved from zeroed pages
+                cell = (char *)sizeClass.freeList;
+                sizeClass.freeList = sizeClass.freeList->next;
+                if (zero) {
+                    std::memset(cell, 0, size);
+                }
+            } else if (sizeClass.bump != sizeClass.bumpEnd) {
+                cell = sizeClass.bump;
+                sizeClass.bump += sizeClass.cellSize;
+            } else {
+                cell = allocSlow(sizeClass, false, zero ? size : 0);
+                if (!cell) {
+                    return nullptr;
+                }
+            }
+
+            setMeta(cell, meta);
+
+            return cell;
+        }
+
+        // allocates small object in young generation, memory is zeroed (young pages are only bump allocated).
+        // returns nullptr if heap can't grow
+        void *allocYoung(std::size_t size, Metadata *meta) {
+            auto &sizeClass = getSizeClass(size);
+            auto &region = sizeClass.young;
+
+            // the same as inline allocation of jitted code
+            if (region.bump != sizeClass.youngEnd) {
+                auto cell = region.bump;
+                region.bump += region.cellSize;
+                *region.meta++ = meta;
+                return cell;
+            }
+
+            auto cell = allocSlow(sizeClass, true, 0);
+            if (!cell) {
+                return nullptr;
+            }
+
+            setMeta(cell, meta);
+
+            return cell;
+        }
+
+        // region which young objects of this size are bump allocated from
+        AllocRegion *getAllocRegion(std::size_t size) { return &getSizeClass(size).young; }
+
+        // opens young regions for inline allocation or closes them, so every allocation goes through allocYoung
+        void setInlineAllocation(bool enabled);
+
+        // returns cell back to its free list right away
+        void free(void *ptr);
+
+        // resizes mapped large object without copying, returns its new address or nullptr if it can't be done
+        void *growLarge(void *ptr, std::size_t newSize);
+
+        Page *findPage(const void *ptr) const { return pageTable.find(ptr); }
+
+        // size of the cell which starts at ptr (0 if ptr is not a heap cell)
+        std::size_t getCellSize(const void *ptr) const;
+
+        Metadata *getMeta(const void *ptr) const {
+            auto page = pageTable.find(ptr);
+            return page ? page->metas[page->getCellIndex(ptr)] : nullptr;
+        }
+
+        void setMeta(const void *ptr, Metadata *meta) {
+            auto page = pageTable.find(ptr);
+            page->metas[page->getCellIndex(ptr)] = meta;
+        }
+
+        bool isYoung(const void *ptr) const {
+            auto page = pageTable.find(ptr);
+            return page && page->young;
+        }
+
+        std::size_t getYoungSize() const { return youngPagesCount * PAGE_SIZE; }
+
+        std::size_t getPagesCount() const { return pages.size(); }
+
+        std::size_t getPagesBytes() const { return pagesBytes; }
+
+        std::size_t getLiveBytes() const { return liveBytes; }
+
+        void setMaxSize(std::size_t size) { maxSize = size; }
+
+        // returns true if ptr is a heap cell which wasn't marked before
+        bool tryMark(const void *ptr) {
+            auto page = pageTable.find(ptr);
+            return page && trySetBit(*page, page->marks.get(), ptr);
+        }
+
+        // same as tryMark, but could be called from several threads at once
+        bool tryMarkAtomic(const void *ptr) {
+            auto page = pageTable.find(ptr);
+            if (!page) {
+                return false;
+            }
+
+            auto [word, bit] = page->getBitPos(ptr);
+            return word != Page::NO_WORD && !(std::atomic_ref(page->marks[word]).fetch_or(bit, std::memory_order_relaxed) & bit);
+        }
+
+        // returns true if ptr is an old cell which wasn't remembered before
+        bool tryRemember(const void *ptr) {
+            auto page = pageTable.find(ptr);
+            return page && !page->young && trySetBit(*page, page->remembered.get(), ptr);
+        }
+
+        void forget(const void *ptr);
+
+        void clearMarks();
+
+        // calls fn(ptr, cellSize, meta) for every old cell marked by the last collection
+        template<typename F>
+        void forEachMarkedCell(F &&fn) const {
+            for (auto &page: pages) {
+                if (!page->young && !page->evacuated) {
+                    forEachMarkedCell(*page, fn);
+                }
+            }
+        }
+
+        template<typename F>
+        static void forEachMarkedCell(const Page &page, F &&fn) {
+            for (std::size_t i = 0; i < page.bitmapWords; i++) {
+                for (auto word = page.marks[i]; word; word &= word - 1) {
+                    auto ptr = page.start + (i * 64 + std::countr_zero(word)) * CELL_ALIGNMENT;
+                    fn((void *)ptr, page.cellSize, page.metas[page.getCellIndex(ptr)]);
+                }
+            }
+        }
+        // frees unmarked old cells
+        void sweep();
+        // frees empty pages and dead large objects, other pages are swept by allocator on demand
+        void sweepLazily();
+        // young pages are empty after minor collection (except pinned ones, which become old)
+        void releaseYoungPages();
+        // marks sparse old pages as evacuated and stops allocating from them, so their live cells could be moved.
+        // pages are taken only from size classes with several sparse pages, otherwise nothing is freed
+        std::vector<Page *> selectEvacuationPages();
+        // evacuated pages are empty after compaction, other pages are unpinned
+        void releaseEvacuatedPages();
+
+    private:
+        SizeClass &getSizeClass(std::size_t size) {
+            return sizeClasses[sizeClassIndex[(size + CELL_ALIGNMENT - 1) / CELL_ALIGNMENT]];
+        }
+
+        static bool trySetBit(const Page &page, uint64_t *bitmap, const void *ptr) {
+            auto [word, bit] = page.getBitPos(ptr);
+            if (word == Page::NO_WORD || (bitmap[word] & bit)) {
+                return false;
+            }
+
+            bitmap[word] |= bit;
+            return true;
+        }
+
+        static bool hasMarks(const Page &page);
+        static std::size_t countLiveBytes(const Page &page);
+
+        // cell from the free list is zeroed up to zeroSize, new pages are zeroed anyway
+        char *allocSlow(SizeClass &sizeClass, bool young, std::size_t zeroSize);
+        void *allocLarge(std::size_t size, Metadata *meta, bool zero);
+        Page *addPage(char *start, std::size_t size, std::size_t cellSize, int sizeClass, bool young);
+        void releasePage(Page &page);
+        // puts unmarked cells to the free list, returns false if the whole page is free
+        bool sweepPage(Page &page);
+        bool canGrow(std::size_t size) const { return !maxSize || pagesBytes + size <= maxSize; }
+        // returns nullptr if heap can't grow
+        char *allocPages(std::size_t size, bool zero);
+        // mmaps PAGE_SIZE aligned range
+        static char *mapPages(std::size_t size);
+    };
+
+    inline std::pair<std::size_t, uint64_t> Page::getBitPos(const void *ptr) const {
+        auto granule = (std::size_t)((const char *)ptr - start) / Heap::CELL_ALIGNMENT;
+        auto word = granule / 64;
+        auto bit = uint64_t(1) << (granule % 64);
+        if (word >= bitmapWords || !(cellStarts[word] & bit)) {
+            return {NO_WORD, 0};
+        }
+
+        return {word, bit};
+    }
+}
@@ -0,0 +1,196 @@
+#include "marker.h"
+
+#include "metadata.h"
+
+namespace X::GC {
+    Marker::Marker(Heap &heap, std::size_t threadsCount) : heap(heap), threadsCount(std::max(threadsCount, std::size_t(1))) {
+        for (std::size_t i = 0; i < this->threadsCount; i++) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+    }
+
+    Marker::~Marker() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        startCv.notify_all();
+
+        for (auto &thread: threads) {
+            thread.join();
+        }
+    }
+
+    void Marker::mark(const std::vector<void *> &roots, bool parallel) {
+        auto workersCount = parallel ? threadsCount : 1;
+        atomicMarks = workersCount > 1;
+
+        if (workersCount == 1) {
+            workers[0]->stack = roots;
+            idleWorkers = 0;
+            work(*workers[0], 1);
+            return;
+        }
+
+        // threads are started lazily, so small programs don't pay for them
+        if (threads.empty()) {
+            startThreads();
+        }
+
+        for (std::size_t i = 0; i < roots.size(); i++) {
+            workers[i % workersCount]->stack.push_back(roots[i]);
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            idleWorkers = 0;
+            doneThreads = 0;
+            epoch++;
+        }
+        startCv.notify_all();
+
+        work(*workers[0], workersCount);
+
+        std::unique_lock lock(mutex);
+        doneCv.wait(lock, [this]() { return doneThreads == threads.size(); });
+    }
+
+    void Marker::startThreads() {
+        for (std::size_t i = 1; i < threadsCount; i++) {
+            threads.emplace_back(&Marker::threadLoop, this, i);
+        }
+    }
+
+    void Marker::threadLoop(std::size_t workerIdx) {
+        uint64_t lastEpoch = 0;
+
+        while (true) {
+            {
+                std::unique_lock lock(mutex);
+                startCv.wait(lock, [&]() { return stopping || epoch != lastEpoch; });
+                if (stopping) {
+                    return;
+                }
+                lastEpoch = epoch;
+            }
+
+            work(*workers[workerIdx], threadsCount);
+
+            {
+                std::lock_guard lock(mutex);
+                doneThreads++;
+            }
+            doneCv.notify_one();
+        }
+    }
+
+    void Marker::work(Worker &worker, std::size_t workersCount) {
+        void *ptr;
+
+        while (true) {
+            while (pop(worker, ptr)) {
+                visit(worker, ptr);
+
+                if (workersCount > 1 && worker.stack.size() > 2 * BATCH_SIZE && !worker.sharedSize.load(std::memory_order_relaxed)) {
+                    publish(worker);
+                }
+            }
+
+            if (workersCount > 1 && steal(worker, workersCount)) {
+                continue;
+            }
+
+            // only busy workers produce work, so we are done when everybody is idle
+            idleWorkers++;
+            while (true) {
+                if (idleWorkers == workersCount) {
+                    return;
+                }
+
+                if (hasSharedWork(workersCount)) {
+                    idleWorkers--;
+                    break;
+                }
+
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void Marker::visit(Worker &worker, void *ptr) {
+        // skips objects which are not allocated by gc (runtime strings for example) or already visited
+        if (!(atomicMarks ? heap.tryMarkAtomic(ptr) : heap.tryMark(ptr))) {
+            return;
+        }
+
+        // cell meta is used instead of the meta of the reference, because object could be an instance of a subclass
+        auto meta = heap.getMeta(ptr);
+        if (!meta) {
+            return; // raw memory
+        }
+
+        forEachField(ptr, meta, [&](void **field) {
+            if (*field) {
+                worker.stack.push_back(*field);
+            }
+        });
+    }
+
+    bool Marker::pop(Worker &worker, void *&ptr) {
+        if (worker.stack.empty() && worker.sharedSize.load(std::memory_order_relaxed)) {
+            // take back what nobody has stolen yet
+            std::lock_guard lock(worker.mutex);
+            worker.stack.insert(worker.stack.end(), worker.shared.begin(), worker.shared.end());
+            worker.shared.clear();
+            worker.sharedSize = 0;
+        }
+
+        if (worker.stack.empty()) {
+            return false;
+        }
+
+        ptr = worker.stack.back();
+        worker.stack.pop_back();
+        return true;
+    }
+
+    void Marker::publish(Worker &worker) {
+        // bottom of the stack is the oldest work, it's likely to be the biggest subgraph
+        std::lock_guard lock(worker.mutex);
+        worker.shared.insert(worker.shared.end(), worker.stack.begin(), worker.stack.begin() + BATCH_SIZE);
+        worker.stack.erase(worker.stack.begin(), worker.stack.begin() + BATCH_SIZE);
+        worker.sharedSize = worker.shared.size();
+    }
+
+    bool Marker::steal(Worker &thief, std::size_t workersCount) {
+        for (std::size_t i = 0; i < workersCount; i++) {
+            auto &victim = *workers[i];
+            if (&victim == &thief || !victim.sharedSize.load(std::memory_order_relaxed)) {
+                continue;
+            }
+
+            std::lock_guard lock(victim.mutex);
+            auto count = (victim.shared.size() + 1) / 2;
+            if (!count) {
+                continue;
+            }
+
+            thief.stack.insert(thief.stack.end(), victim.shared.begin(), victim.shared.begin() + count);
+            victim.shared.erase(victim.shared.begin(), victim.shared.begin() + count);
+            victim.sharedSize = victim.shared.size();
+            return true;
+        }
+
+        return false;
+    }
+
+    bool Marker::hasSharedWork(std::size_t workersCount) const {
+        for (std::size_t i = 0; i < workersCount; i++) {
+            if (workers[i]->sharedSize.load(std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "heap.h"
+
+namespace X::GC {
+    // marks objects reachable from roots using several threads, idle threads steal work from busy ones
+    class Marker {
+        struct Worker {
+            // private stack, only owner touches it
+            std::vector<void *> stack;
+            // part of the work which could be stolen by other workers
+            std::mutex mutex;
+            std::deque<void *> shared;
+            std::atomic<std::size_t> sharedSize = 0;
+        };
+
+        // objects are moved to the shared deque by batches
+        static constexpr std::size_t BATCH_SIZE = 64;
+
+        Heap &heap;
+        std::size_t threadsCount;
+        // worker 0 is the thread which called mark
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+
+        std::mutex mutex;
+        std::condition_variable startCv;
+        std::condition_variable doneCv;
+        uint64_t epoch = 0;
+        std::size_t doneThreads = 0;
+        bool stopping = false;
+
+        std::atomic<std::size_t> idleWorkers = 0;
+        // plain marking is cheaper when there is only one worker
+        bool atomicMarks = false;
+
+    public:
+        Marker(Heap &heap, std::size_t threadsCount);
+        Marker(const Marker &) = delete;
+        Marker &operator=(const Marker &) = delete;
+        ~Marker();
+
+        // marks are expected to be cleared
+        void mark(const std::vector<void *> &roots, bool parallel);
+
+    private:
+        void startThreads();
+        void threadLoop(std::size_t workerIdx);
+
+        void work(Worker &worker, std::size_t workersCount);
+        void visit(Worker &worker, void *ptr);
+        bool pop(Worker &worker, void *&ptr);
+        void publish(Worker &worker);
+        bool steal(Worker &thief, std::size_t workersCount);
+        bool hasSharedWork(std::size_t workersCount) const;
+    };
+}
@@ -0,0 +1,32 @@
+#include "memory_manager.h"
+
+namespace X::GC {
+    uint8_t *StackMapMemoryManager::allocateDataSection(uintptr_t size, unsigned alignment, unsigned sectionID, llvm::StringRef sectionName, bool isReadOnly) {
+        auto ptr = SectionMemoryManager::allocateDataSection(size, alignment, sectionID, sectionName, isReadOnly);
+
+        if (sectionName == STACK_MAP_SECTION_NAME) {
+            stackMapSections.emplace_back(ptr, size);
+        }
+
+        return ptr;
+    }
+
+    // relocations are already applied, so stack map contains real function addresses
+    bool StackMapMemoryManager::finalizeMemory(std::string *errMsg) {
+        try {
+            for (auto [ptr, size]: stackMapSections) {
+                gc.addStackMap(ptr, size);
+            }
+        } catch (const StackMapException &e) {
+            if (errMsg) {
+                *errMsg = e.what();
+            }
+
+            return true;
+        }
+
+        stackMapSections.clear();
+
+        return SectionMemoryManager::finalizeMemory(errMsg);
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+
+#include "gc.h"
+
+namespace X::GC {
+    // passes stack maps of jitted code to gc
+    class StackMapMemoryManager : public llvm::SectionMemoryManager {
+        static inline const std::string STACK_MAP_SECTION_NAME = ".llvm_stackmaps";
+
+        GC &gc;
+        std::vector<std::pair<uint8_t *, uintptr_t>> stackMapSections;
+
+    public:
+        explicit StackMapMemoryManager(GC &gc) : gc(gc) {}
+
+        uint8_t *allocateDataSection(uintptr_t size, unsigned alignment, unsigned sectionID, llvm::StringRef sectionName, bool isReadOnly) override;
+        bool finalizeMemory(std::string *errMsg) override;
+    };
+}
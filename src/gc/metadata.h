@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace X::GC {
+    struct Metadata;
+
+    enum class NodeType {
+        CLASS,
+        // interface values aren't allocated, they are {obj ptr, vtable} pairs kept in the slots of other objects
+        INTERFACE,
+        ARRAY,
+    };
+
+    // pair<offset, meta>
+    using PointerList = std::vector<std::pair<unsigned long, Metadata *>>;
+
+    struct Metadata {
+        NodeType type;
+        PointerList pointerList;
+        // type name for heap census
+        std::string name;
+    };
+
+    // layout of runtime arrays, elements of small arrays are kept in the same cell right after the header
+    struct ArrayHeader {
+        void *data;
+        int64_t len;
+        int64_t cap;
+    };
+
+    inline bool hasInlineData(const void *arr) {
+        return ((const ArrayHeader *)arr)->data == (const char *)arr + sizeof(ArrayHeader);
+    }
+
+    // calls fn for every pointer field of the object (array data is visited before array elements)
+    template<typename F>
+    void forEachField(void *ptr, Metadata *meta, F &&fn) {
+        switch (meta->type) {
+            case NodeType::CLASS:
+                for (auto [offset, _]: meta->pointerList) {
+                    fn((void **)((uint64_t)ptr + offset));
+                }
+
+                break;
+            case NodeType::INTERFACE:
+                break;
+            case NodeType::ARRAY: {
+                auto arr = (ArrayHeader *)ptr;
+
+                // inline data is a part of the array cell
+                if (!hasInlineData(arr)) {
+                    fn(&arr->data);
+                }
+
+                // array is not constructed yet or it's scalar array
+                if (!arr->data || meta->pointerList.empty()) {
+                    break;
+                }
+
+                // only the first word of interface value points to the heap
+                auto stride = meta->pointerList[0].second->type == NodeType::INTERFACE ? 2 : 1;
+                for (int64_t i = 0; i < arr->len; i++) {
+                    fn((void **)arr->data + i * stride);
+                }
+
+                break;
+            }
+        }
+    }
+}
@@ -2,21 +2,22 @@
 
 #include <vector>
 
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
+#include "gc.h"
+#include "heap.h"
 #include "mangler.h"
+#include "metadata.h"
+#include "stack_map.h"
 
 namespace X::GC {
     llvm::PreservedAnalyses XGCLowering::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
-        auto M = F.getParent();
-        auto gcPushStackFrameFn = M->getFunction(mangler->mangleInternalFunction("gcPushStackFrame"));
-        auto gcPopStackFrameFn = M->getFunction(mangler->mangleInternalFunction("gcPopStackFrame"));
-        auto gcAddRootFn = M->getFunction(mangler->mangleInternalFunction("gcAddRoot"));
-        auto gcVar = M->getGlobalVariable(mangler->mangleInternalSymbol("gc"));
-
         if (!F.hasGC() || F.getGC() != "x") {
             return llvm::PreservedAnalyses::all();
         }
@@ -38,27 +39,452 @@ namespace X::GC {
             return llvm::PreservedAnalyses::all();
         }
 
-        // push stack frame
+        auto &context = F.getContext();
+        auto stackTopVar = F.getParent()->getGlobalVariable(mangler->mangleInternalSymbol("gcStackTop"));
+        auto ptrType = llvm::PointerType::get(context, 0);
+        auto int64Type = llvm::Type::getInt64Ty(context);
+
+        // same layout as GC::StackFrame: previous frame, roots count, root slots
+        auto frameType = llvm::StructType::get(context, {ptrType, int64Type, llvm::ArrayType::get(ptrType, roots.size())});
+
         llvm::IRBuilder<> builder(&F.getEntryBlock(), F.getEntryBlock().begin());
+        auto frame = builder.CreateAlloca(frameType, nullptr, "gc.frame");
+
         builder.SetInsertPointPastAllocas(&F);
-        builder.CreateCall(gcPushStackFrameFn, {gcVar});
+        builder.CreateStore(builder.getInt64(roots.size()), builder.CreateStructGEP(frameType, frame, 1));
+        for (auto i = 0; i < roots.size(); i++) {
+            builder.CreateStore(roots[i]->getArgOperand(0), builder.CreateConstGEP2_32(frameType, frame, 0, 2 + i));
+        }
+
+        // push stack frame
+        auto prevFrame = builder.CreateLoad(ptrType, stackTopVar, "gc.prev");
+        builder.CreateStore(prevFrame, builder.CreateStructGEP(frameType, frame, 0));
+        builder.CreateStore(frame, stackTopVar);
 
-        // replace gcroot intrinsic
         for (auto root: roots) {
-            llvm::ReplaceInstWithInst(root, llvm::CallInst::Create(gcAddRootFn, {gcVar, root->getArgOperand(0), root->getArgOperand(1)}));
+            root->eraseFromParent();
         }
 
         // pop stack frame
         for (auto &BB: F) {
             if (auto terminator = BB.getTerminator()) {
                 if (llvm::isa<llvm::ReturnInst>(terminator)) {
-                    llvm::CallInst::Create(gcPopStackFrameFn, {gcVar}, "", terminator);
+                    new llvm::StoreInst(prevFrame, stackTopVar, terminator);
+                }
+            }
+        }
+
+        llvm::PreservedAnalyses PA;
+        PA.preserveSet<llvm::CFGAnalyses>();
+        return PA;
+    }
+
+    llvm::PreservedAnalyses XStackAllocation::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+        if (!F.hasGC()) {
+            return llvm::PreservedAnalyses::all();
+        }
+
+        std::vector<llvm::CallInst *> allocs;
+
+        for (auto &BB: F) {
+            for (auto &instruction: BB) {
+                if (auto call = llvm::dyn_cast<llvm::CallInst>(&instruction); call && canAllocateOnStack(call)) {
+                    allocs.push_back(call);
+                }
+            }
+        }
+
+        if (allocs.empty()) {
+            return llvm::PreservedAnalyses::all();
+        }
+
+        auto &loopInfo = FAM.getResult<llvm::LoopAnalysis>(F);
+        llvm::AllocaInst *nullSlot = nullptr;
+        auto changed = false;
+
+        for (auto alloc: allocs) {
+            Escape escape;
+            if (!doesNotEscape(alloc, escape)) {
+                continue;
+            }
+
+            // stack memory of the object is reused by every iteration
+            if (loopInfo.getLoopFor(alloc->getParent()) && !isReloadedAfter(alloc, escape)) {
+                continue;
+            }
+
+            llvm::IRBuilder<> entryBuilder(&F.getEntryBlock(), F.getEntryBlock().begin());
+            auto size = llvm::cast<llvm::ConstantInt>(alloc->getArgOperand(1));
+            auto obj = entryBuilder.CreateAlloca(llvm::ArrayType::get(entryBuilder.getInt8Ty(), size->getZExtValue()), nullptr, "obj");
+            obj->setAlignment(llvm::Align(Heap::CELL_ALIGNMENT));
+
+            // gc returns zeroed memory
+            llvm::IRBuilder<> builder(alloc);
+            builder.CreateMemSet(obj, builder.getInt8(0), size, obj->getAlign());
+
+            // variables which hold nothing but this object don't have to be roots anymore,
+            // so they (and the object after them) could be promoted to registers
+            llvm::SmallPtrSet<llvm::AllocaInst *, 4> heapSlots;
+            for (auto slot: escape.slots) {
+                auto holdsOnlyObject = llvm::all_of(slot->users(), [&](llvm::User *user) {
+                    auto store = llvm::dyn_cast<llvm::StoreInst>(user);
+                    if (!store || store->getPointerOperand() != slot) {
+                        return true;
+                    }
+
+                    auto value = store->getValueOperand();
+                    return escape.values.contains(value) || llvm::isa<llvm::ConstantPointerNull>(value);
+                });
+
+                if (!holdsOnlyObject) {
+                    heapSlots.insert(slot);
+                    continue;
+                }
+
+                std::vector<llvm::User *> registrations;
+                for (auto user: slot->users()) {
+                    if (isRootRegistration(user, slot)) {
+                        registrations.push_back(user);
+                    }
+                }
+
+                for (auto registration: registrations) {
+                    if (llvm::isa<llvm::IntrinsicInst>(registration)) {
+                        llvm::cast<llvm::Instruction>(registration)->eraseFromParent();
+                        continue;
+                    }
+
+                    // shadow stack frame has fixed number of slots, so it gets a slot which is always null
+                    if (!nullSlot) {
+                        nullSlot = entryBuilder.CreateAlloca(entryBuilder.getPtrTy(), nullptr, "gc.null");
+                        llvm::IRBuilder<> nullBuilder(&F.getEntryBlock(), F.getEntryBlock().begin());
+                        nullBuilder.SetInsertPointPastAllocas(&F);
+                        nullBuilder.CreateStore(llvm::ConstantPointerNull::get(nullBuilder.getPtrTy()), nullSlot);
+                    }
+                    registration->replaceUsesOfWith(slot, nullSlot);
+                }
+            }
+
+            // barrier is a no-op for stack object, but the call would keep its address escaped
+            for (auto writeBarrier: escape.writeBarriers) {
+                auto load = llvm::dyn_cast<llvm::LoadInst>(writeBarrier->getArgOperand(1));
+                auto slot = load ? llvm::dyn_cast<llvm::AllocaInst>(load->getPointerOperand()) : nullptr;
+                if (!slot || !heapSlots.contains(slot)) {
+                    writeBarrier->eraseFromParent();
                 }
             }
+
+            alloc->replaceAllUsesWith(obj);
+            alloc->eraseFromParent();
+            changed = true;
+        }
+
+        if (!changed) {
+            return llvm::PreservedAnalyses::all();
         }
 
         llvm::PreservedAnalyses PA;
-        PA.preserve<llvm::DominatorTreeAnalysis>();
+        PA.preserveSet<llvm::CFGAnalyses>();
         return PA;
     }
+
+    bool XStackAllocation::canAllocateOnStack(llvm::CallInst *alloc) const {
+        auto fn = alloc->getCalledFunction();
+        if (!fn || fn->getName() != mangler->mangleInternalFunction("gcAlloc")) {
+            return false;
+        }
+
+        auto size = llvm::dyn_cast<llvm::ConstantInt>(alloc->getArgOperand(1));
+        if (!size || size->getZExtValue() > MAX_OBJECT_SIZE) {
+            return false;
+        }
+
+        // meta is passed as a symbol named after it (see Codegen::getGCMetaValue)
+        auto metaVar = llvm::dyn_cast<llvm::GlobalVariable>(alloc->getArgOperand(2));
+        if (!metaVar) {
+            return false;
+        }
+
+        auto metaName = metaVar->getName();
+        auto metaPrefix = mangler->mangleGCMeta("");
+        if (!metaName.starts_with(metaPrefix)) {
+            return false;
+        }
+
+        auto &metas = gc->getNamedMetas();
+        auto metaIt = metas.find(metaName.substr(metaPrefix.size()).str());
+        if (metaIt == metas.cend()) {
+            return false;
+        }
+
+        // gc doesn't scan the stack objects, so they can't reference heap objects
+        auto meta = metaIt->second;
+        return meta->type == NodeType::CLASS && meta->pointerList.empty();
+    }
+
+    bool XStackAllocation::doesNotEscape(llvm::CallInst *alloc, Escape &escape) const {
+        auto writeBarrierFnName = mangler->mangleInternalFunction("gcWriteBarrier");
+        std::vector<llvm::Value *> worklist{alloc};
+        escape.values.insert(alloc);
+
+        auto track = [&](llvm::Value *value) {
+            if (escape.values.insert(value).second) {
+                worklist.push_back(value);
+            }
+        };
+
+        while (!worklist.empty()) {
+            auto value = worklist.back();
+            worklist.pop_back();
+
+            for (auto user: value->users()) {
+                if (llvm::isa<llvm::GetElementPtrInst>(user)) {
+                    track(user);
+                    continue;
+                }
+
+                if (llvm::isa<llvm::LoadInst>(user) || llvm::isa<llvm::ICmpInst>(user)) {
+                    continue;
+                }
+
+                if (auto store = llvm::dyn_cast<llvm::StoreInst>(user)) {
+                    if (store->getValueOperand() != value) {
+                        continue; // field store
+                    }
+
+                    // object could be stored only to local variables
+                    auto slot = llvm::dyn_cast<llvm::AllocaInst>(store->getPointerOperand());
+                    if (!slot || !isRootSlot(slot)) {
+                        return false;
+                    }
+
+                    if (escape.slots.insert(slot)) {
+                        for (auto slotUser: slot->users()) {
+                            if (llvm::isa<llvm::LoadInst>(slotUser)) {
+                                track(slotUser);
+                            }
+                        }
+                    }
+                    continue;
+                }
+
+                if (auto call = llvm::dyn_cast<llvm::CallInst>(user)) {
+                    auto fn = call->getCalledFunction();
+                    if (fn && fn->getName() == writeBarrierFnName && call->getArgOperand(1) == value) {
+                        escape.writeBarriers.push_back(call);
+                        continue;
+                    }
+                }
+
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool XStackAllocation::isRootSlot(llvm::AllocaInst *slot) const {
+        if (!slot->isStaticAlloca() || !slot->getAllocatedType()->isPointerTy()) {
+            return false;
+        }
+
+        return llvm::all_of(slot->users(), [&](llvm::User *user) {
+            if (llvm::isa<llvm::LoadInst>(user)) {
+                return true;
+            }
+
+            if (auto store = llvm::dyn_cast<llvm::StoreInst>(user); store && store->getValueOperand() != slot) {
+                return true;
+            }
+
+            return isRootRegistration(user, slot);
+        });
+    }
+
+    bool XStackAllocation::isRootRegistration(llvm::User *user, llvm::AllocaInst *slot) const {
+        if (auto intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(user)) {
+            return intrinsic->getIntrinsicID() == llvm::Intrinsic::gcroot && intrinsic->getArgOperand(0) == slot;
+        }
+
+        auto store = llvm::dyn_cast<llvm::StoreInst>(user);
+        if (!store || store->getValueOperand() != slot) {
+            return false;
+        }
+
+        // slot address is stored to the shadow stack frame, which is linked by the store to x.gcStackTop
+        auto frame = llvm::dyn_cast<llvm::AllocaInst>(llvm::getUnderlyingObject(store->getPointerOperand()));
+        if (!frame) {
+            return false;
+        }
+
+        auto stackTopVar = store->getModule()->getGlobalVariable(mangler->mangleInternalSymbol("gcStackTop"));
+
+        return llvm::any_of(frame->users(), [&](llvm::User *frameUser) {
+            auto link = llvm::dyn_cast<llvm::StoreInst>(frameUser);
+            return link && link->getValueOperand() == frame && link->getPointerOperand() == stackTopVar;
+        });
+    }
+
+    bool XStackAllocation::isReloadedAfter(llvm::CallInst *alloc, const Escape &escape) const {
+        for (auto slot: escape.slots) {
+            for (auto user: slot->users()) {
+                auto load = llvm::dyn_cast<llvm::LoadInst>(user);
+                if (!load) {
+                    continue;
+                }
+
+                if (load->getParent() != alloc->getParent() || !alloc->comesBefore(load)) {
+                    return false;
+                }
+
+                // variable must be assigned between allocation and load
+                auto assigned = false;
+                for (auto it = alloc->getIterator(); &*it != load; it++) {
+                    if (auto store = llvm::dyn_cast<llvm::StoreInst>(&*it); store && store->getPointerOperand() == slot) {
+                        assigned = true;
+                        break;
+                    }
+                }
+
+                if (!assigned) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    llvm::PreservedAnalyses XInlineAllocation::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+        auto allocFnName = mangler->mangleInternalFunction("gcAlloc");
+        std::vector<std::pair<llvm::CallInst *, AllocRegion *>> allocs;
+
+        for (auto &BB: F) {
+            for (auto &instruction: BB) {
+                auto call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+                auto fn = call ? call->getCalledFunction() : nullptr;
+                if (!fn || fn->getName() != allocFnName) {
+                    continue;
+                }
+
+                auto size = llvm::dyn_cast<llvm::ConstantInt>(call->getArgOperand(1));
+                if (!size) {
+                    continue;
+                }
+
+                if (auto region = gc->getAllocRegion(size->getZExtValue())) {
+                    allocs.emplace_back(call, region);
+                }
+            }
+        }
+
+        if (allocs.empty()) {
+            return llvm::PreservedAnalyses::all();
+        }
+
+        auto &context = F.getContext();
+        auto ptrType = llvm::PointerType::get(context, 0);
+        auto int64Type = llvm::Type::getInt64Ty(context);
+        // {bump, limit, meta} (see AllocRegion)
+        auto regionType = llvm::StructType::get(context, {ptrType, ptrType, ptrType});
+        // gc data is linked by name, so the code doesn't depend on its address and could be cached
+        auto allocatedBytes = F.getParent()->getOrInsertGlobal(mangler->mangleInternalSymbol("gcAllocatedBytes"), int64Type);
+        // region runs out once per page
+        auto weights = llvm::MDBuilder(context).createBranchWeights(1000, 1);
+
+        for (auto [alloc, region]: allocs) {
+            llvm::IRBuilder<> builder(alloc);
+            auto regionPtr = F.getParent()->getOrInsertGlobal(mangler->mangleAllocRegion(region->cellSize), regionType);
+            auto bumpPtr = builder.CreateStructGEP(regionType, regionPtr, 0);
+            auto bump = builder.CreateLoad(ptrType, bumpPtr, "bump");
+            auto limit = builder.CreateLoad(ptrType, builder.CreateStructGEP(regionType, regionPtr, 1), "limit");
+            auto fits = builder.CreateICmpULT(bump, limit);
+
+            llvm::Instruction *fastTerm, *slowTerm;
+            llvm::SplitBlockAndInsertIfThenElse(fits, alloc, &fastTerm, &slowTerm, weights);
+            auto tail = alloc->getParent();
+
+            // pages are zeroed, so the cell is ready after its meta is set
+            builder.SetInsertPoint(fastTerm);
+            builder.CreateStore(builder.CreateConstGEP1_64(builder.getInt8Ty(), bump, region->cellSize), bumpPtr);
+            auto metaPtr = builder.CreateStructGEP(regionType, regionPtr, 2);
+            auto meta = builder.CreateLoad(ptrType, metaPtr, "meta");
+            builder.CreateStore(alloc->getArgOperand(2), meta);
+            builder.CreateStore(builder.CreateConstGEP1_64(ptrType, meta, 1), metaPtr);
+            auto bytes = builder.CreateLoad(int64Type, allocatedBytes);
+            builder.CreateStore(builder.CreateAdd(bytes, alloc->getArgOperand(1)), allocatedBytes);
+
+            alloc->moveBefore(slowTerm);
+
+            builder.SetInsertPoint(tail, tail->begin());
+            auto obj = builder.CreatePHI(ptrType, 2, "obj");
+            alloc->replaceAllUsesWith(obj);
+            obj->addIncoming(bump, fastTerm->getParent());
+            obj->addIncoming(alloc, slowTerm->getParent());
+        }
+
+        return llvm::PreservedAnalyses::none();
+    }
+
+    llvm::PreservedAnalyses XStatepointLowering::run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM) {
+        if (F.isDeclaration()) {
+            return llvm::PreservedAnalyses::all();
+        }
+
+        // gc finds stack maps of the frames by walking frame pointers
+        F.addFnAttr("frame-pointer", "all");
+
+        if (!F.hasGC() || F.getGC() != "x-statepoint") {
+            return llvm::PreservedAnalyses::all();
+        }
+
+        std::vector<llvm::Value *> roots;
+        std::vector<llvm::IntrinsicInst *> gcroots;
+        std::vector<llvm::CallInst *> calls;
+
+        for (auto &BB: F) {
+            for (auto &instruction: BB) {
+                if (auto intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(&instruction)) {
+                    if (intrinsic->getIntrinsicID() == llvm::Intrinsic::gcroot) {
+                        gcroots.push_back(intrinsic);
+                        roots.push_back(intrinsic->getArgOperand(0)->stripPointerCasts());
+                    }
+
+                    continue;
+                }
+
+                if (auto call = llvm::dyn_cast<llvm::CallInst>(&instruction)) {
+                    // varargs functions (like print) and gc leafs don't allocate
+                    if (call->isInlineAsm() || call->isMustTailCall() || call->getFunctionType()->isVarArg() || call->hasFnAttr("gc-leaf-function")) {
+                        continue;
+                    }
+
+                    calls.push_back(call);
+                }
+            }
+        }
+
+        for (auto gcroot: gcroots) {
+            gcroot->eraseFromParent();
+        }
+
+        if (roots.empty()) {
+            return gcroots.empty() ? llvm::PreservedAnalyses::all() : llvm::PreservedAnalyses::none();
+        }
+
+        for (auto call: calls) {
+            llvm::IRBuilder<> builder(call);
+            std::vector<llvm::Value *> args(call->arg_begin(), call->arg_end());
+
+            auto statepoint = builder.CreateGCStatepointCall(StackMap::STATEPOINT_ID, 0, llvm::FunctionCallee(call->getFunctionType(), call->getCalledOperand()),
+                                                             args, std::nullopt, roots);
+            if (!call->getType()->isVoidTy()) {
+                call->replaceAllUsesWith(builder.CreateGCResult(statepoint, call->getType()));
+            }
+
+            call->eraseFromParent();
+        }
+
+        return llvm::PreservedAnalyses::none();
+    }
 }
@@ -1,10 +1,15 @@
 #pragma once
 
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/PassManager.h"
 
 #include "mangler.h"
 
 namespace X::GC {
+    class GC;
+
     class XGCLowering : public llvm::PassInfoMixin<XGCLowering> {
         std::shared_ptr<Mangler> mangler;
 
@@ -13,4 +18,56 @@ namespace X::GC {
 
         llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
     };
+
+    // allocates objects which don't escape the function on the stack, so they can be broken into registers.
+    // runs after inlining, because otherwise object pointer escapes to the constructor
+    class XStackAllocation : public llvm::PassInfoMixin<XStackAllocation> {
+        // bigger objects are left on the heap to keep frames small
+        static constexpr uint64_t MAX_OBJECT_SIZE = 256;
+
+        std::shared_ptr<Mangler> mangler;
+        std::shared_ptr<GC> gc;
+
+        struct Escape {
+            // object pointer and values which could hold it (field pointers, loads of local variables)
+            llvm::SmallPtrSet<llvm::Value *, 16> values;
+            // local variables which hold the object
+            llvm::SmallSetVector<llvm::AllocaInst *, 4> slots;
+            std::vector<llvm::CallInst *> writeBarriers;
+        };
+
+    public:
+        XStackAllocation(std::shared_ptr<Mangler> mangler, std::shared_ptr<GC> gc) : mangler(std::move(mangler)), gc(std::move(gc)) {}
+
+        llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+    private:
+        bool canAllocateOnStack(llvm::CallInst *alloc) const;
+        bool doesNotEscape(llvm::CallInst *alloc, Escape &escape) const;
+        bool isRootSlot(llvm::AllocaInst *slot) const;
+        bool isRootRegistration(llvm::User *user, llvm::AllocaInst *slot) const;
+        // checks that variables don't keep the object of the previous loop iteration
+        bool isReloadedAfter(llvm::CallInst *alloc, const Escape &escape) const;
+    };
+
+    // allocates young objects of constant size by bumping the region of their size class right in jitted code,
+    // gc is called only when the region is exhausted or closed. runs after inlining, so stack allocation sees every gcAlloc call
+    class XInlineAllocation : public llvm::PassInfoMixin<XInlineAllocation> {
+        std::shared_ptr<Mangler> mangler;
+        std::shared_ptr<GC> gc;
+
+    public:
+        XInlineAllocation(std::shared_ptr<Mangler> mangler, std::shared_ptr<GC> gc) : mangler(std::move(mangler)), gc(std::move(gc)) {}
+
+        llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+    };
+
+    // replaces gcroot intrinsics with gc.statepoint calls, so root slots are recorded in stack map.
+    // runs after optimizations, because statepoints block them.
+    // root slots are passed as gc-live, so pointers are still spilled to them around calls,
+    // unlike RewriteStatepointsForGC, which needs pointers in addrspace(1) and could keep them in registers
+    class XStatepointLowering : public llvm::PassInfoMixin<XStatepointLowering> {
+    public:
+        llvm::PreservedAnalyses run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+    };
 }
@@ -0,0 +1,163 @@
+#include "stack_map.h"
+
+#include <cstring>
+
+namespace X::GC {
+    namespace {
+        enum class LocationType : uint8_t {
+            REGISTER = 1,
+            DIRECT = 2,
+            INDIRECT = 3,
+            CONSTANT = 4,
+            CONSTANT_INDEX = 5,
+        };
+
+        // x86-64 dwarf register numbers
+        constexpr uint16_t FRAME_POINTER_REG = 6;
+        constexpr uint16_t STACK_POINTER_REG = 7;
+        // saved frame pointer and return address
+        constexpr std::size_t FRAME_RECORD_SIZE = 2 * sizeof(void *);
+
+        // statepoint record starts with calling convention, flags and number of deopt locations
+        constexpr std::size_t STATEPOINT_HEADER_LOCATIONS = 3;
+
+        class Reader {
+            const uint8_t *data;
+            std::size_t size;
+            std::size_t pos = 0;
+
+        public:
+            Reader(const uint8_t *data, std::size_t size) : data(data), size(size) {}
+
+            template<typename T>
+            T read() {
+                if (pos + sizeof(T) > size) {
+                    throw StackMapException("unexpected end of stack map");
+                }
+
+                T value;
+                std::memcpy(&value, data + pos, sizeof(T));
+                pos += sizeof(T);
+                return value;
+            }
+
+            void skip(std::size_t n) { pos += n; }
+
+            void align(std::size_t alignment) { pos = (pos + alignment - 1) / alignment * alignment; }
+        };
+
+        struct Location {
+            LocationType type;
+            uint16_t reg;
+            int32_t offset;
+        };
+    }
+
+    void StackMap::addSection(const uint8_t *data, std::size_t size) {
+#if !defined(__x86_64__)
+        throw StackMapException("stack maps are supported on x86-64 only");
+#endif
+
+        Reader reader(data, size);
+
+        auto version = reader.read<uint8_t>();
+        if (version != VERSION) {
+            throw StackMapException("unsupported stack map version " + std::to_string(version));
+        }
+        reader.skip(3);
+
+        auto functionsCount = reader.read<uint32_t>();
+        auto constantsCount = reader.read<uint32_t>();
+        reader.skip(sizeof(uint32_t)); // records count, records are counted per function
+
+        // function address, stack size, records count
+        std::vector<std::pair<uintptr_t, uint64_t>> functions;
+        functions.reserve(functionsCount);
+        for (uint32_t i = 0; i < functionsCount; i++) {
+            auto address = reader.read<uint64_t>();
+            reader.skip(sizeof(uint64_t));
+            auto recordsCount = reader.read<uint64_t>();
+            functions.emplace_back(address, recordsCount);
+        }
+
+        reader.skip(constantsCount * sizeof(uint64_t));
+
+        std::unordered_map<uintptr_t, std::vector<StackSlot>> sectionCallSites;
+
+        for (auto [address, recordsCount]: functions) {
+            for (uint64_t i = 0; i < recordsCount; i++) {
+                auto id = reader.read<uint64_t>();
+                auto instructionOffset = reader.read<uint32_t>();
+                reader.skip(sizeof(uint16_t));
+                auto locationsCount = reader.read<uint16_t>();
+
+                std::vector<Location> locations;
+                locations.reserve(locationsCount);
+                for (uint16_t j = 0; j < locationsCount; j++) {
+                    auto type = (LocationType)reader.read<uint8_t>();
+                    reader.skip(sizeof(uint8_t) + sizeof(uint16_t));
+                    auto reg = reader.read<uint16_t>();
+                    reader.skip(sizeof(uint16_t));
+                    auto offset = reader.read<int32_t>();
+                    locations.push_back({type, reg, offset});
+                }
+
+                // live outs are not used
+                reader.align(8);
+                reader.skip(sizeof(uint16_t));
+                auto liveOutsCount = reader.read<uint16_t>();
+                reader.skip(liveOutsCount * sizeof(uint32_t));
+                reader.align(8);
+
+                if (id != STATEPOINT_ID) {
+                    continue;
+                }
+
+                if (locations.size() < STATEPOINT_HEADER_LOCATIONS) {
+                    throw StackMapException("invalid statepoint record");
+                }
+
+                auto deoptLocationsCount = locations[STATEPOINT_HEADER_LOCATIONS - 1].offset;
+                std::vector<StackSlot> slots;
+
+                // roots are allocas, so they are always direct locations
+                for (auto j = STATEPOINT_HEADER_LOCATIONS + deoptLocationsCount; j < locations.size(); j++) {
+                    auto &location = locations[j];
+                    if (location.type != LocationType::DIRECT ||
+                        (location.reg != FRAME_POINTER_REG && location.reg != STACK_POINTER_REG)) {
+                        throw StackMapException("unsupported gc root location");
+                    }
+
+                    slots.push_back({location.reg == FRAME_POINTER_REG, location.offset});
+                }
+
+                sectionCallSites[address + instructionOffset] = std::move(slots);
+            }
+        }
+
+        std::lock_guard lock(mutex);
+        callSites.merge(sectionCallSites);
+    }
+
+    void StackMap::forEachRoot(const void *stackBase, const std::function<void(void **)> &fn) const {
+        std::lock_guard lock(mutex);
+        auto fp = (void **)__builtin_frame_address(0);
+
+        while (fp && fp < stackBase) {
+            auto returnAddress = (uintptr_t)fp[1];
+            auto callerFp = (void **)fp[0];
+
+            auto it = callSites.find(returnAddress);
+            if (it != callSites.cend()) {
+                // stack pointer of the caller at the call site is right above return address
+                auto callerSp = (char *)fp + FRAME_RECORD_SIZE;
+
+                for (auto &slot: it->second) {
+                    fn((void **)((slot.fromFramePointer ? (char *)callerFp : callerSp) + slot.offset));
+                }
+            }
+
+            fp = callerFp;
+        }
+    }
+}
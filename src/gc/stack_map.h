@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace X::GC {
+    // root slot of the frame, offset is relative to stack pointer (or frame pointer) of the frame at the call site
+    struct StackSlot {
+        bool fromFramePointer;
+        int32_t offset;
+    };
+
+    // stack maps emitted by llvm for gc.statepoint calls (https://llvm.org/docs/StackMaps.html)
+    class StackMap {
+        static constexpr uint8_t VERSION = 3;
+
+        // return address -> root slots of the calling frame
+        std::unordered_map<uintptr_t, std::vector<StackSlot>> callSites;
+        // sections of hot functions are added by background compilation (see TieredCompiler)
+        mutable std::mutex mutex;
+
+    public:
+        // id of statepoints which keep gc roots, other records are ignored
+        static constexpr uint64_t STATEPOINT_ID = 0x7867;
+
+        // parses .llvm_stackmaps section (after relocations are applied)
+        void addSection(const uint8_t *data, std::size_t size);
+
+        bool empty() const {
+            std::lock_guard lock(mutex);
+            return callSites.empty();
+        }
+
+        // walks frame pointers up to stackBase and calls fn for every root slot of the frames,
+        // so every frame between the caller and stackBase must keep frame pointer
+        [[gnu::noinline]] void forEachRoot(const void *stackBase, const std::function<void(void **)> &fn) const;
+    };
+
+    class StackMapException : public std::exception {
+        std::string message;
+
+    public:
+        StackMapException(std::string s) : message(std::move(s)) {}
+
+        const char *what() const noexcept override {
+            return message.c_str();
+        }
+    };
+}
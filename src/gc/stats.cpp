@@ -0,0 +1,73 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <bit>
+
+#include <sys/resource.h>
+
+namespace X::GC {
+    void Stats::addPause(std::chrono::nanoseconds pause) {
+        auto us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(pause).count();
+        auto bucket = std::min((std::size_t)std::bit_width(us), PAUSE_BUCKETS - 1);
+        pauseHistogram[bucket]++;
+        maxPause = std::max(maxPause, pause);
+    }
+
+    void Stats::toJSON(std::ostream &os) const {
+        auto us = [](std::chrono::nanoseconds duration) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+        };
+
+        os << "{\n";
+        os << "  \"collections\": " << collections << ",\n";
+        os << "  \"minorCollections\": " << minorCollections << ",\n";
+        os << "  \"markTimeUs\": " << us(markTime) << ",\n";
+        os << "  \"sweepTimeUs\": " << us(sweepTime) << ",\n";
+        os << "  \"minorTimeUs\": " << us(minorTime) << ",\n";
+        os << "  \"compactTimeUs\": " << us(compactTime) << ",\n";
+        os << "  \"maxPauseUs\": " << us(maxPause) << ",\n";
+
+        // bucket upper bound in microseconds -> number of pauses
+        os << "  \"pauseHistogramUs\": {";
+        for (std::size_t i = 0; i < PAUSE_BUCKETS; i++) {
+            os << (i ? ", " : "") << '"';
+            if (i == PAUSE_BUCKETS - 1) {
+                os << "inf";
+            } else {
+                os << (uint64_t(1) << i);
+            }
+            os << "\": " << pauseHistogram[i];
+        }
+        os << "},\n";
+
+        os << "  \"allocatedBytes\": " << allocatedBytes << ",\n";
+        os << "  \"freedBytes\": " << freedBytes << ",\n";
+        os << "  \"promotedBytes\": " << promotedBytes << ",\n";
+        os << "  \"compactedBytes\": " << compactedBytes << ",\n";
+        os << "  \"liveBytes\": " << liveBytes << ",\n";
+        os << "  \"maxLiveBytes\": " << maxLiveBytes << ",\n";
+        os << "  \"heapBytes\": " << heapBytes << ",\n";
+        os << "  \"peakRssBytes\": " << peakRssBytes << "\n";
+        os << "}\n";
+    }
+
+    std::vector<std::pair<int64_t, Stats::AllocationSite>> Stats::getTopAllocationSites(std::size_t n) const {
+        std::vector<std::pair<int64_t, AllocationSite>> sites(allocationSites.begin(), allocationSites.end());
+        std::ranges::sort(sites, [](const auto &a, const auto &b) { return a.second.bytes > b.second.bytes; });
+        sites.resize(std::min(n, sites.size()));
+        return sites;
+    }
+
+    std::size_t Stats::getPeakRss() {
+        rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage)) {
+            return 0;
+        }
+
+#ifdef __APPLE__
+        return usage.ru_maxrss;
+#else
+        return usage.ru_maxrss * 1024; // kilobytes
+#endif
+    }
+}
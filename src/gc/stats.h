@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace X::GC {
+    struct Stats {
+        // pauses are counted in buckets of [0, 1us), [1us, 2us), [2us, 4us) ... [~0.5s, inf)
+        static constexpr std::size_t PAUSE_BUCKETS = 21;
+
+        std::size_t collections = 0;
+        std::size_t minorCollections = 0;
+
+        std::chrono::nanoseconds markTime{};
+        std::chrono::nanoseconds sweepTime{};
+        std::chrono::nanoseconds minorTime{};
+        std::chrono::nanoseconds compactTime{};
+        std::chrono::nanoseconds maxPause{};
+        std::array<std::size_t, PAUSE_BUCKETS> pauseHistogram{};
+
+        std::size_t allocatedBytes = 0;
+        std::size_t freedBytes = 0;
+        // bytes copied from young generation to the old one
+        std::size_t promotedBytes = 0;
+        // bytes moved out of sparse pages by compaction
+        std::size_t compactedBytes = 0;
+        // bytes of marked objects after the last full collection
+        std::size_t liveBytes = 0;
+        std::size_t maxLiveBytes = 0;
+        // size of heap pages (including free cells) at the moment stats were taken
+        std::size_t heapBytes = 0;
+        std::size_t peakRssBytes = 0;
+
+        struct AllocationSite {
+            std::size_t count = 0;
+            std::size_t bytes = 0;
+        };
+        // source line -> allocations made while its statement was executed (0 is unknown line),
+        // it's filled only if Options::profileAllocations is set
+        std::unordered_map<int64_t, AllocationSite> allocationSites;
+
+        void addPause(std::chrono::nanoseconds pause);
+        void addAllocation(int64_t line, std::size_t size) {
+            auto &site = allocationSites[line];
+            site.count++;
+            site.bytes += size;
+        }
+        // {line, site} pairs sorted by bytes
+        std::vector<std::pair<int64_t, AllocationSite>> getTopAllocationSites(std::size_t n) const;
+        void toJSON(std::ostream &os) const;
+
+        static std::size_t getPeakRss();
+    };
+}
@@ -2,5 +2,6 @@
 
 namespace X::GC {
     static llvm::GCRegistry::Add<XGCStrategy> X("x", "Mark-and-sweep gc");
+    static llvm::GCRegistry::Add<XStatepointGCStrategy> XStatepoint("x-statepoint", "Mark-and-sweep gc with stack maps");
 }
 
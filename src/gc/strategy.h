@@ -1,5 +1,7 @@
 #pragma once
 
+#include <optional>
+
 #include "llvm/IR/GCStrategy.h"
 
 namespace X::GC {
@@ -7,4 +9,16 @@ namespace X::GC {
     public:
         XGCStrategy() = default;
     };
+
+    // roots are still kept in allocas, statepoints just record their stack slots in stack map
+    class XStatepointGCStrategy : public llvm::GCStrategy {
+    public:
+        XStatepointGCStrategy() {
+            UseStatepoints = true;
+        }
+
+        std::optional<bool> isGCManagedPointer(const llvm::Type *Ty) const override {
+            return false;
+        }
+    };
 }
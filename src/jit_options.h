@@ -0,0 +1,32 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <thread>
+
+namespace X {
+    struct JITOptions {
+        // functions are optimized and compiled on the first call instead of before main runs
+        bool lazy = false;
+        // functions start unoptimized and are recompiled with O3 when they get hot (see TieredCompiler)
+        bool tiered = false;
+        // calls and loop iterations of the function after which it's recompiled
+        uint64_t tierUpThreshold = 10000;
+        // big modules are split into this many parts, which are optimized and compiled in parallel
+        std::size_t compileThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    };
+
+    struct JITStats {
+        // functions switched to the second tier (see TieredCompiler)
+        std::size_t recompiledFunctions = 0;
+        // parts of the module which were compiled in parallel, 1 if the module wasn't split
+        std::size_t moduleParts = 1;
+        // functions which were compiled by lazy jit
+        std::set<std::string> lazyCompiledFunctions;
+        // objects which were loaded from the cache instead of compiling (see ObjectCache)
+        std::size_t cacheHits = 0;
+    };
+}
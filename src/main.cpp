@@ -1,16 +1,121 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <filesystem>
 
 #include "compiler.h"
 
+static const std::string GC_STATS_FLAG = "--gc-stats";
+static const std::string GC_CENSUS_FLAG = "--gc-census";
+static const std::string GC_PROFILE_ALLOCATIONS_FLAG = "--gc-profile-allocations";
+static const std::string BUILD_COMMAND = "build";
+static const std::size_t DEFAULT_TOP_ALLOCATION_SITES = 10;
+
+// parses size like 512, 64K, 16M or 2G
+static std::size_t parseSize(const std::string &s) {
+    std::size_t pos;
+    auto size = std::stoull(s, &pos);
+    auto suffix = s.substr(pos);
+
+    if (suffix.empty()) {
+        return size;
+    } else if (suffix == "K" || suffix == "k") {
+        return size * 1024;
+    } else if (suffix == "M" || suffix == "m") {
+        return size * 1024 * 1024;
+    } else if (suffix == "G" || suffix == "g") {
+        return size * 1024 * 1024 * 1024;
+    }
+
+    throw std::invalid_argument("invalid size " + s);
+}
+
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        std::cerr << "missing input file" << std::endl;
+    std::string filename;
+    X::GC::Options gcOptions;
+    bool dumpGCStats = false;
+    // stats are printed to stderr if file is not set
+    std::string gcStatsFilename;
+    // census is printed to stderr if file is not set
+    std::string gcCensusFilename;
+    std::size_t topAllocationSites = DEFAULT_TOP_ALLOCATION_SITES;
+    // compiled objects of unchanged programs are loaded from here
+    std::string cacheDir;
+    X::JITOptions jitOptions;
+    // x build foo.x -o foo compiles the program into executable instead of running it
+    bool build = argc > 1 && argv[1] == BUILD_COMMAND;
+    std::string outputFilename;
+
+    try {
+        for (auto i = build ? 2 : 1; i < argc; i++) {
+            std::string arg = argv[i];
+            auto valuePos = arg.find('=');
+            auto name = arg.substr(0, valuePos);
+            auto value = valuePos == std::string::npos ? "" : arg.substr(valuePos + 1);
+
+            if (name == GC_STATS_FLAG) {
+                dumpGCStats = true;
+                gcStatsFilename = value;
+            } else if (name == GC_CENSUS_FLAG) {
+                gcOptions.census = true;
+                gcCensusFilename = value;
+            } else if (name == GC_PROFILE_ALLOCATIONS_FLAG) {
+                gcOptions.profileAllocations = true;
+                if (!value.empty()) {
+                    topAllocationSites = std::stoull(value);
+                }
+            } else if (name == "--gc-census-path") {
+                gcOptions.censusPathType = value;
+            } else if (name == "--gc-initial-heap") {
+                gcOptions.threshold = parseSize(value);
+            } else if (name == "--gc-growth-factor") {
+                gcOptions.heapGrowthFactor = std::stod(value);
+            } else if (name == "--gc-max-heap") {
+                gcOptions.maxHeapSize = parseSize(value);
+            } else if (name == "--gc-compact") {
+                gcOptions.compact = true;
+            } else if (name == "--gc-nursery") {
+                gcOptions.nurserySize = parseSize(value);
+            } else if (name == "--gc-mark-threads") {
+                gcOptions.markThreads = std::max(std::stoull(value), 1ull);
+            } else if (name == "--gc-eager-sweep") {
+                gcOptions.lazySweep = false;
+            } else if (name == "--gc-stack-maps") {
+                gcOptions.stackMaps = true;
+            } else if (name == "--cache-dir") {
+                cacheDir = value;
+            } else if (name == "--jit-lazy") {
+                jitOptions.lazy = true;
+            } else if (name == "--jit-tiered") {
+                jitOptions.tiered = true;
+            } else if (name == "--jit-tier-up-threshold") {
+                jitOptions.tierUpThreshold = std::stoull(value);
+            } else if (name == "--jit-threads") {
+                jitOptions.compileThreads = std::stoull(value);
+            } else if (build && arg == "-o") {
+                if (i + 1 == argc) {
+                    std::cerr << "missing output file" << std::endl;
+                    return 1;
+                }
+                outputFilename = argv[++i];
+            } else if (arg.starts_with("--")) {
+                std::cerr << "unknown option " << name << std::endl;
+                return 1;
+            } else {
+                filename = arg;
+            }
+        }
+    } catch (const std::logic_error &e) {
+        // std::stoull and std::stod throw subclasses of logic_error
+        std::cerr << "invalid option value" << std::endl;
         return 1;
     }
 
-    std::string filename = argv[1];
+    if (filename.empty()) {
+        std::cerr << "missing input file" << std::endl;
+        return 1;
+    }
 
     std::ifstream fin(filename);
     if (!fin) {
@@ -21,9 +126,56 @@ int main(int argc, char *argv[]) {
     buffer << fin.rdbuf();
     std::string code = buffer.str();
 
-    X::Compiler compiler;
+    X::Compiler compiler(gcOptions, cacheDir, jitOptions);
+
+    if (build) {
+        if (outputFilename.empty()) {
+            outputFilename = std::filesystem::path(filename).stem();
+        }
+
+        return compiler.build(code, filename, outputFilename);
+    }
 
     compiler.compile(code, filename);
 
+    if (dumpGCStats) {
+        if (gcStatsFilename.empty()) {
+            compiler.getGCStats().toJSON(std::cerr);
+        } else {
+            std::ofstream fout(gcStatsFilename);
+            if (!fout) {
+                std::cerr << "couldn't open gc stats file" << std::endl;
+                return 1;
+            }
+            compiler.getGCStats().toJSON(fout);
+        }
+    }
+
+    if (gcOptions.census) {
+        if (gcCensusFilename.empty()) {
+            compiler.getGCCensus().toJSON(std::cerr);
+        } else {
+            std::ofstream fout(gcCensusFilename);
+            if (!fout) {
+                std::cerr << "couldn't open gc census file" << std::endl;
+                return 1;
+            }
+            compiler.getGCCensus().toJSON(fout);
+        }
+    }
+
+    if (gcOptions.profileAllocations) {
+        std::cerr << "top allocation sites:" << std::endl;
+        for (auto &[line, site]: compiler.getGCStats().getTopAllocationSites(topAllocationSites)) {
+            std::cerr << "  " << filename << ':';
+            if (line) {
+                std::cerr << line;
+            } else {
+                std::cerr << '?';
+            }
+            std::cerr << ": " << site.count << " allocations, " << site.bytes << " bytes" << std::endl;
+        }
+    }
+
     return 0;
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 namespace X {
@@ -38,5 +39,17 @@ namespace X {
         std::string mangleInternalSymbol(const std::string &symbol) {
             return INTERNAL_PREFIX + symbol;
         }
+
+        bool isInternalSymbol(const std::string &symbol) {
+            return symbol.starts_with(INTERNAL_PREFIX);
+        }
+
+        std::string mangleGCMeta(const std::string &metaName) {
+            return INTERNAL_PREFIX + "gcMeta." + metaName;
+        }
+
+        std::string mangleAllocRegion(std::size_t cellSize) {
+            return INTERNAL_PREFIX + "gcAllocRegion." + std::to_string(cellSize);
+        }
     };
 }
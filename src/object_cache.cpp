@@ -0,0 +1,76 @@
+#include "object_cache.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace X {
+    std::string ObjectCache::getKey(const llvm::Module &module, const std::string &salt) {
+        std::string ir;
+        llvm::raw_string_ostream os(ir);
+        module.print(os, nullptr);
+        os.flush();
+
+        llvm::MD5 hash;
+        hash.update(salt);
+        hash.update(ir);
+        llvm::MD5::MD5Result result;
+        hash.final(result);
+
+        return result.digest().str().str();
+    }
+
+    bool ObjectCache::prefetch(const llvm::Module &module) {
+        auto obj = llvm::MemoryBuffer::getFile(getPath(module));
+        if (!obj) {
+            return false;
+        }
+
+        prefetched[module.getModuleIdentifier()] = std::move(*obj);
+        return true;
+    }
+
+    void ObjectCache::notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef obj) {
+        // cache is optional, so the object just isn't stored on errors
+        if (llvm::sys::fs::create_directories(dir)) {
+            return;
+        }
+
+        auto path = getPath(*module);
+        int fd;
+        llvm::SmallString<128> tmpPath;
+        if (llvm::sys::fs::createUniqueFile(path + ".%%%%%%.tmp", fd, tmpPath)) {
+            return;
+        }
+
+        llvm::raw_fd_ostream os(fd, true);
+        os << obj.getBuffer();
+        os.close();
+
+        // the same object could be stored by concurrent runs, rename replaces it atomically
+        if (os.has_error() || llvm::sys::fs::rename(tmpPath, path)) {
+            os.clear_error();
+            llvm::sys::fs::remove(tmpPath);
+        }
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> ObjectCache::getObject(const llvm::Module *module) {
+        auto it = prefetched.find(module->getModuleIdentifier());
+        if (it == prefetched.end()) {
+            return nullptr;
+        }
+
+        auto obj = std::move(it->second);
+        prefetched.erase(it);
+        hits++;
+        return obj;
+    }
+
+    std::string ObjectCache::getPath(const llvm::Module &module) const {
+        llvm::SmallString<128> path(dir);
+        llvm::sys::path::append(path, module.getModuleIdentifier() + ".o");
+        return path.str().str();
+    }
+}
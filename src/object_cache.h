@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace X {
+    // keeps objects of jitted modules in a directory. module identifier is the cache key (see ObjectCache::getKey)
+    class ObjectCache : public llvm::ObjectCache {
+        std::string dir;
+        // objects which were found before compilation, so the module isn't optimized in vain
+        std::unordered_map<std::string, std::unique_ptr<llvm::MemoryBuffer>> prefetched;
+        // objects which were given to the compiler instead of compiling their modules
+        std::size_t hits = 0;
+
+    public:
+        explicit ObjectCache(std::string dir) : dir(std::move(dir)) {}
+
+        // hash of unoptimized module ir and everything else which affects the object (target, compiler version, options)
+        static std::string getKey(const llvm::Module &module, const std::string &salt);
+
+        // returns true if object of the module is cached, it will be given to the compiler instead of compiling the module
+        bool prefetch(const llvm::Module &module);
+
+        void notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef obj) override;
+        std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *module) override;
+
+        std::size_t getHits() const { return hits; }
+
+    private:
+        std::string getPath(const llvm::Module &module) const;
+    };
+}
@@ -144,6 +144,7 @@ maybe_comment:
 top_statement_list:
 %empty { $$ = new TopStatementListNode; }
 | top_statement_list top_statement maybe_comment '\n' {
+    $2->line = @2.begin.line;
     $1->add($2);
     if ($3) $1->add($3);
     $$ = $1;
@@ -162,6 +163,7 @@ class_decl { $$ = $1; }
 statement_list:
 %empty { $$ = new StatementListNode; }
 | statement_list statement maybe_comment '\n' {
+    $2->line = @2.begin.line;
     $1->add($2);
     if ($3) $1->add($3);
     $$ = $1;
@@ -370,6 +372,7 @@ class_members_block:
 class_members_list:
 %empty { $$ = new StatementListNode; }
 | class_members_list class_member maybe_comment '\n' {
+    $2->line = @2.begin.line;
     $1->add($2);
     if ($3) $1->add($3);
     $$ = $1;
@@ -1,23 +1,42 @@
 #include "code_generator.h"
 
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
 #include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Transforms/Scalar/SROA.h"
+#include "llvm/Transforms/Utils/Mem2Reg.h"
 
 #include "codegen/codegen.h"
+#include "object_cache.h"
+#include "utils.h"
+#include "tiered_compiler.h"
 #include "runtime/runtime.h"
 #include "gc/pass.h"
+#include "gc/memory_manager.h"
 
 namespace X::Pipes {
     TopStatementListNode *CodeGenerator::handle(TopStatementListNode *node) {
+        if (jitOptions.lazy && jitOptions.tiered) {
+            throw CodeGeneratorException("lazy and tiered jit can't be combined");
+        }
+
         auto context = std::make_unique<llvm::LLVMContext>();
         llvm::IRBuilder<> builder(*context);
         auto module = std::make_unique<llvm::Module>(sourceName, *context);
-        auto gc = std::make_shared<GC::GC>();
+        auto gc = std::make_shared<GC::GC>(gcOptions);
         auto mangler = std::make_shared<Mangler>();
         auto arrayRuntime = std::make_unique<Runtime::ArrayRuntime>(*context, *module, mangler);
         Codegen::Codegen codegen(*context, builder, *module, compilerRuntime, std::move(arrayRuntime), gc, mangler);
@@ -38,18 +57,138 @@ namespace X::Pipes {
             throw CodeGeneratorException(os.str());
         }
 
-        auto jitter = throwOnError(llvm::orc::LLJITBuilder().create());
-        jitter->getIRTransformLayer().setTransform(OptimizationTransform(mangler));
-        throwOnError(jitter->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context))));
+        // runtime data is referenced through got, so the code could be loaded at any address
+        auto JTMB = throwOnError(llvm::orc::JITTargetMachineBuilder::detectHost());
+        JTMB.setRelocationModel(llvm::Reloc::PIC_);
+        JTMB.setCodeModel(llvm::CodeModel::Small);
+        // the first tier is compiled as fast as possible, the second one gets its own target machine
+        auto tier1JTMB = JTMB;
+        if (jitOptions.tiered) {
+            JTMB.setCodeGenOptLevel(llvm::CodeGenOptLevel::None);
+        }
+
+        // optimization and machine code generation are skipped if the object is cached.
+        // lazy and tiered jits compile parts of the module, so only whole modules are cached
+        std::unique_ptr<ObjectCache> objectCache;
+        bool cached = false;
+        if (!cacheDir.empty() && !jitOptions.lazy && !jitOptions.tiered) {
+            objectCache = std::make_unique<ObjectCache>(cacheDir);
+            module->setModuleIdentifier(ObjectCache::getKey(*module, getCacheSalt(JTMB)));
+            cached = objectCache->prefetch(*module);
+        }
+
+        auto setUpJIT = [&](auto &jitterBuilder) {
+            if (objectCache) {
+                jitterBuilder.setCompileFunctionCreator(
+                        [cache = objectCache.get()](llvm::orc::JITTargetMachineBuilder JTMB) -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+                            auto TM = JTMB.createTargetMachine();
+                            if (!TM) {
+                                return TM.takeError();
+                            }
+
+                            return std::make_unique<llvm::orc::TMOwningSimpleCompiler>(std::move(*TM), cache);
+                        });
+            }
+
+            jitterBuilder.setJITTargetMachineBuilder(std::move(JTMB));
+
+            if (gcOptions.stackMaps) {
+                jitterBuilder.setObjectLinkingLayerCreator(
+                        [gc](llvm::orc::ExecutionSession &ES, const llvm::Triple &TT) -> llvm::Expected<std::unique_ptr<llvm::orc::ObjectLayer>> {
+                            return std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(ES, [gc](const llvm::MemoryBuffer &) {
+                                return std::make_unique<GC::StackMapMemoryManager>(*gc);
+                            });
+                        });
+            }
+        };
+
+        llvm::orc::ThreadSafeModule TSM(std::move(module), std::move(context));
+        // filled by the jitter, so it's destroyed after it
+        std::set<std::string> lazyCompiledFunctions;
+        std::mutex lazyCompiledFunctionsMutex;
+        std::unique_ptr<llvm::orc::LLJIT> jitter;
+        // uses the jitter, so it's destroyed first
+        std::unique_ptr<TieredCompiler> tieredCompiler;
+        std::size_t modulePartsCount = 1;
+
+        if (jitOptions.lazy) {
+            // every function is optimized and compiled separately when it's called for the first time
+            llvm::orc::LLLazyJITBuilder jitterBuilder;
+            setUpJIT(jitterBuilder);
+            auto lazyJitter = throwOnError(jitterBuilder.create());
+            lazyJitter->getIRTransformLayer().setTransform(
+                    [&, transform = OptimizationTransform(mangler, gc)](llvm::orc::ThreadSafeModule TSM, llvm::orc::MaterializationResponsibility &R) mutable {
+                        TSM.withModuleDo([&](llvm::Module &module) {
+                            std::lock_guard lock(lazyCompiledFunctionsMutex);
+                            for (auto &fn: module) {
+                                if (!fn.isDeclaration()) {
+                                    lazyCompiledFunctions.insert(fn.getName().str());
+                                }
+                            }
+                        });
+
+                        return transform(std::move(TSM), R);
+                    });
+            throwOnError(lazyJitter->addLazyIRModule(std::move(TSM)));
+            jitter = std::move(lazyJitter);
+        } else if (jitOptions.tiered) {
+            llvm::orc::LLJITBuilder jitterBuilder;
+            setUpJIT(jitterBuilder);
+            jitter = throwOnError(jitterBuilder.create());
+            jitter->getIRTransformLayer().setTransform(OptimizationTransform(mangler, gc, llvm::OptimizationLevel::O0));
+            tieredCompiler = std::make_unique<TieredCompiler>(*jitter, std::move(tier1JTMB), mangler, gc, jitOptions.tierUpThreshold);
+            throwOnError(tieredCompiler->addModule(std::move(TSM)));
+        } else {
+            // object cache keeps whole modules
+            std::vector<llvm::orc::ThreadSafeModule> partitions;
+            if (!objectCache) {
+                partitions = splitModule(TSM, *mangler);
+            }
+
+            llvm::orc::LLJITBuilder jitterBuilder;
+            setUpJIT(jitterBuilder);
+            if (!partitions.empty()) {
+                jitterBuilder.setNumCompileThreads(partitions.size());
+            } else {
+                partitions.push_back(std::move(TSM));
+            }
+
+            modulePartsCount = partitions.size();
+
+            jitter = throwOnError(jitterBuilder.create());
+            if (!cached) {
+                jitter->getIRTransformLayer().setTransform(OptimizationTransform(mangler, gc));
+            }
+
+            for (auto &partition: partitions) {
+                throwOnError(jitter->addIRModule(std::move(partition)));
+            }
+        }
 
         llvm::orc::MangleAndInterner llvmMangle(jitter->getExecutionSession(), jitter->getDataLayout());
         runtime.addDefinitions(jitter->getMainJITDylib(), llvmMangle);
+        defineGCSymbols(jitter->getMainJITDylib(), llvmMangle, *mangler, *gc);
+
+        if (tieredCompiler) {
+            throwOnError(tieredCompiler->start());
+        }
 
         // link gc
         auto runtimeGCSymbol = throwOnError(jitter->lookup(mangler->mangleInternalSymbol("gc")));
         auto runtimeGCPtr = runtimeGCSymbol.toPtr<GC::GC **>();
         *runtimeGCPtr = &(*gc); // nolint
 
+        auto runtimeStackTopSymbol = throwOnError(jitter->lookup(mangler->mangleInternalSymbol("gcStackTop")));
+        gc->setStackTop(runtimeStackTopSymbol.toPtr<GC::StackFrame **>());
+
+        if (gcOptions.profileAllocations) {
+            auto runtimeAllocSiteSymbol = throwOnError(jitter->lookup(mangler->mangleInternalSymbol("gcAllocSite")));
+            gc->setAllocSite(runtimeAllocSiteSymbol.toPtr<const int64_t *>());
+        }
+
+        // stack maps roots are searched in the frames below this one
+        gc->setStackBase(__builtin_frame_address(0));
+
         // run init
         auto maybeInitFn = jitter->lookup(mangler->mangleInternalFunction(Codegen::Codegen::INIT_FN_NAME));
         if (maybeInitFn) {
@@ -62,12 +201,149 @@ namespace X::Pipes {
         auto *fn = mainFn.toPtr<void()>();
         fn();
 
-        // we can't run gc in alloc for now because we don't have intermediate roots ("h(f(), g())"),
         gc->run();
 
+        if (gcStats) {
+            *gcStats = gc->getStats();
+        }
+
+        if (gcCensus) {
+            *gcCensus = gc->getCensus();
+        }
+
+        if (jitStats) {
+            std::lock_guard lock(lazyCompiledFunctionsMutex);
+            *jitStats = {.moduleParts = modulePartsCount, .lazyCompiledFunctions = lazyCompiledFunctions,
+                         .cacheHits = objectCache ? objectCache->getHits() : 0};
+
+            if (tieredCompiler) {
+                // hot functions could still be compiling, stats must not depend on timing
+                tieredCompiler->wait();
+                jitStats->recompiledFunctions = tieredCompiler->getRecompiledCount();
+            }
+        }
+
         return node;
     }
 
+    void CodeGenerator::defineGCSymbols(llvm::orc::JITDylib &JD, llvm::orc::MangleAndInterner &llvmMangle, Mangler &mangler, GC::GC &gc) const {
+        llvm::orc::SymbolMap symbols;
+        auto define = [&](const std::string &name, const void *ptr) {
+            symbols[llvmMangle(name)] = llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(ptr), llvm::JITSymbolFlags());
+        };
+
+        for (auto &[name, meta]: gc.getNamedMetas()) {
+            define(mangler.mangleGCMeta(name), meta);
+        }
+
+        for (auto size: GC::Heap::SIZE_CLASSES) {
+            if (auto region = gc.getAllocRegion(size)) {
+                define(mangler.mangleAllocRegion(size), region);
+            }
+        }
+
+        define(mangler.mangleInternalSymbol("gcAllocatedBytes"), gc.getAllocatedBytesCounter());
+
+        throwOnError(JD.define(llvm::orc::absoluteSymbols(std::move(symbols))));
+    }
+
+    std::vector<llvm::orc::ThreadSafeModule> CodeGenerator::splitModule(llvm::orc::ThreadSafeModule &TSM, Mangler &mangler) const {
+        std::unordered_map<const llvm::GlobalValue *, std::size_t> functionPartitions;
+        std::size_t partitionsCount = 0;
+
+        TSM.withModuleDo([&](llvm::Module &module) {
+            // methods of a class are kept together, so they could be inlined into each other
+            // (see Mangler::mangleMethod and Mangler::mangleHiddenMethod).
+            // class names could contain '_', so the group is the longest class name which prefixes the method name
+            auto classPrefix = mangler.mangleClass("");
+            std::vector<llvm::StringRef> classNames;
+            for (auto type: module.getIdentifiedStructTypes()) {
+                if (type->getName().starts_with(classPrefix)) {
+                    classNames.push_back(type->getName());
+                }
+            }
+
+            auto getGroup = [&](llvm::StringRef name) {
+                llvm::StringRef group = name;
+                for (auto className: classNames) {
+                    if (name.size() > className.size() && name.starts_with(className) &&
+                        (name[className.size()] == '_' || name[className.size()] == '.') &&
+                        (group == name || className.size() > group.size())) {
+                        group = className;
+                    }
+                }
+                return group;
+            };
+
+            std::map<llvm::StringRef, std::pair<std::size_t, std::vector<const llvm::Function *>>> groups;
+            std::size_t instructionsCount = 0;
+
+            for (auto &fn: module) {
+                if (fn.isDeclaration()) {
+                    continue;
+                }
+
+                auto name = fn.getName();
+                auto &[size, fns] = groups[getGroup(name)];
+                size += fn.getInstructionCount();
+                fns.push_back(&fn);
+                instructionsCount += fn.getInstructionCount();
+            }
+
+            if (jitOptions.compileThreads < 2 || groups.size() < 2 || instructionsCount < PARALLEL_COMPILE_MIN_INSTRUCTIONS) {
+                return;
+            }
+
+            // parts refer to each other
+            externalizeLocals(module, mangler.mangleInternalSymbol("local"));
+
+            // the largest groups go first, every group is added to the smallest part
+            std::vector<std::pair<std::size_t, std::vector<const llvm::Function *>>> sortedGroups;
+            for (auto &[_, group]: groups) {
+                sortedGroups.push_back(std::move(group));
+            }
+            std::ranges::sort(sortedGroups, [](const auto &a, const auto &b) { return a.first > b.first; });
+
+            partitionsCount = std::min(jitOptions.compileThreads, sortedGroups.size());
+            std::vector<std::size_t> sizes(partitionsCount);
+            for (auto &[size, fns]: sortedGroups) {
+                auto partition = std::ranges::min_element(sizes) - sizes.begin();
+                sizes[partition] += size;
+                for (auto fn: fns) {
+                    functionPartitions[fn] = partition;
+                }
+            }
+        });
+
+        std::vector<llvm::orc::ThreadSafeModule> partitions;
+
+        for (std::size_t i = 0; i < partitionsCount; i++) {
+            partitions.push_back(llvm::orc::cloneToNewContext(TSM, [&](const llvm::GlobalValue &value) {
+                auto it = functionPartitions.find(&value);
+                if (it != functionPartitions.end()) {
+                    return it->second == i;
+                }
+
+                // variables are defined by the first part, local constants are copied to every part
+                return i == 0 || value.hasLocalLinkage();
+            }));
+        }
+
+        return partitions;
+    }
+
+    std::string CodeGenerator::getCacheSalt(const llvm::orc::JITTargetMachineBuilder &JTMB) const {
+        std::string salt;
+        llvm::raw_string_ostream os(salt);
+
+        os << X_VERSION << ' ' << LLVM_VERSION_STRING << ' ' << JTMB.getTargetTriple().str() << ' ' << JTMB.getCPU() << ' '
+           << JTMB.getFeatures().getString();
+        // passes depend on these options (see OptimizationTransform)
+        os << ' ' << gcOptions.stackMaps << ' ' << (gcOptions.nurserySize && !gcOptions.profileAllocations);
+
+        return os.str();
+    }
+
     void CodeGenerator::throwOnError(llvm::Error &&err) const {
         if (err) {
             throw CodeGeneratorException(llvm::toString(std::move(err)));
@@ -84,6 +360,14 @@ namespace X::Pipes {
 
     llvm::Expected<llvm::orc::ThreadSafeModule> OptimizationTransform::operator()(
             llvm::orc::ThreadSafeModule TSM, llvm::orc::MaterializationResponsibility &R) {
+        TSM.withModuleDo([&](llvm::Module &module) {
+            run(module);
+        });
+
+        return std::move(TSM);
+    }
+
+    void OptimizationTransform::run(llvm::Module &module) {
         llvm::LoopAnalysisManager LAM;
         llvm::FunctionAnalysisManager FAM;
         llvm::CGSCCAnalysisManager CGAM;
@@ -101,12 +385,26 @@ namespace X::Pipes {
             MPM.addPass(llvm::createModuleToFunctionPassAdaptor(GC::XGCLowering(mangler)));
         });
 
-        llvm::ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2);
+        // after inlining and before the last sroa, which breaks stack objects into registers
+        PB.registerScalarOptimizerLateEPCallback([&](llvm::FunctionPassManager &FPM, llvm::OptimizationLevel Level) {
+            FPM.addPass(GC::XStackAllocation(mangler, gc));
+            FPM.addPass(llvm::PromotePass());
+            FPM.addPass(llvm::SROAPass(llvm::SROAOptions::ModifyCFG));
+        });
 
-        TSM.withModuleDo([&](llvm::Module &module) {
-            MPM.run(module, MAM);
+        // after all inlining, so stack allocation has seen every gcAlloc call
+        PB.registerOptimizerLastEPCallback([&](llvm::ModulePassManager &MPM, llvm::OptimizationLevel Level) {
+            MPM.addPass(llvm::createModuleToFunctionPassAdaptor(GC::XInlineAllocation(mangler, gc)));
         });
 
-        return std::move(TSM);
+        if (gc->getOptions().stackMaps) {
+            PB.registerOptimizerLastEPCallback([&](llvm::ModulePassManager &MPM, llvm::OptimizationLevel Level) {
+                MPM.addPass(llvm::createModuleToFunctionPassAdaptor(GC::XStatepointLowering()));
+            });
+        }
+
+        llvm::ModulePassManager MPM = level == llvm::OptimizationLevel::O0 ? PB.buildO0DefaultPipeline(level) : PB.buildPerModuleDefaultPipeline(level);
+
+        MPM.run(module, MAM);
     }
 }
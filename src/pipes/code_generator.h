@@ -4,24 +4,51 @@
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
 #include "llvm/ExecutionEngine/Orc/Core.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/Mangling.h"
 
 #include "pipeline.h"
 #include "mangler.h"
 #include "compiler_runtime.h"
+#include "jit_options.h"
+#include "gc/gc.h"
 
 namespace X::Pipes {
     // todo rename
     class CodeGenerator : public Pipe {
+        // splitting of small modules costs more than parallel compilation saves
+        static constexpr std::size_t PARALLEL_COMPILE_MIN_INSTRUCTIONS = 4096;
+
         std::shared_ptr<CompilerRuntime> compilerRuntime;
         std::string sourceName;
+        GC::Options gcOptions;
+        // gc stats and heap census are copied here when program finishes
+        GC::Stats *gcStats;
+        GC::Census *gcCensus;
+        // compiled objects are cached in this directory, empty string disables the cache
+        std::string cacheDir;
+        JITOptions jitOptions;
+        // jit stats are copied here when program finishes
+        JITStats *jitStats;
 
     public:
-        CodeGenerator(std::shared_ptr<CompilerRuntime> compilerRuntime, std::string sourceName) : compilerRuntime(std::move(compilerRuntime)),
-                                                                                                  sourceName(std::move(sourceName)) {}
+        CodeGenerator(std::shared_ptr<CompilerRuntime> compilerRuntime, std::string sourceName, GC::Options gcOptions = {},
+                      GC::Stats *gcStats = nullptr, GC::Census *gcCensus = nullptr, std::string cacheDir = "", JITOptions jitOptions = {},
+                      JITStats *jitStats = nullptr) :
+                compilerRuntime(std::move(compilerRuntime)), sourceName(std::move(sourceName)), gcOptions(std::move(gcOptions)),
+                gcStats(gcStats), gcCensus(gcCensus), cacheDir(std::move(cacheDir)), jitOptions(jitOptions), jitStats(jitStats) {}
 
         TopStatementListNode *handle(TopStatementListNode *node) override;
 
     private:
+        // gc data used by jitted code is linked by name (metas, alloc regions)
+        void defineGCSymbols(llvm::orc::JITDylib &JD, llvm::orc::MangleAndInterner &llvmMangle, Mangler &mangler, GC::GC &gc) const;
+        // splits big module into parts in their own contexts, so they could be compiled in parallel.
+        // returns nothing if the module isn't worth splitting
+        std::vector<llvm::orc::ThreadSafeModule> splitModule(llvm::orc::ThreadSafeModule &TSM, Mangler &mangler) const;
+        // everything except module ir which affects the compiled object
+        std::string getCacheSalt(const llvm::orc::JITTargetMachineBuilder &JTMB) const;
+
         void throwOnError(llvm::Error &&err) const;
 
         template<typename T>
@@ -30,11 +57,16 @@ namespace X::Pipes {
 
     class OptimizationTransform {
         std::shared_ptr<Mangler> mangler;
+        std::shared_ptr<GC::GC> gc;
+        // gc passes run on every level, O0 is the first tier of tiered jit
+        llvm::OptimizationLevel level;
 
     public:
-        OptimizationTransform(std::shared_ptr<Mangler> mangler) : mangler(std::move(mangler)) {}
+        OptimizationTransform(std::shared_ptr<Mangler> mangler, std::shared_ptr<GC::GC> gc, llvm::OptimizationLevel level = llvm::OptimizationLevel::O2) :
+                mangler(std::move(mangler)), gc(std::move(gc)), level(level) {}
 
         llvm::Expected<llvm::orc::ThreadSafeModule> operator()(llvm::orc::ThreadSafeModule TSM, llvm::orc::MaterializationResponsibility &R);
+        void run(llvm::Module &module);
     };
 
     class CodeGeneratorException : public std::exception {
@@ -0,0 +1,279 @@
+#include "executable_emitter.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+#include <sys/wait.h>
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "code_generator.h"
+#include "codegen/codegen.h"
+#include "runtime/program.h"
+
+namespace X::Pipes {
+    TopStatementListNode *ExecutableEmitter::handle(TopStatementListNode *node) {
+        auto context = std::make_unique<llvm::LLVMContext>();
+        llvm::IRBuilder<> builder(*context);
+        auto module = std::make_unique<llvm::Module>(sourceName, *context);
+        // gc of the compiler only keeps metas. alloc regions belong to the gc of the executable, so allocations aren't inlined
+        auto gc = std::make_shared<GC::GC>(GC::Options{.nurserySize = 0, .markThreads = 1});
+        auto mangler = std::make_shared<Mangler>();
+        auto arrayRuntime = std::make_unique<Runtime::ArrayRuntime>(*context, *module, mangler);
+        Codegen::Codegen codegen(*context, builder, *module, compilerRuntime, std::move(arrayRuntime), gc, mangler);
+        Runtime::Runtime runtime(mangler);
+
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+
+        runtime.addDeclarations(*context, builder, *module);
+
+        codegen.genProgram(node);
+
+        // executable is built for the host, the same way as jitted code
+        auto JTMB = throwOnError(llvm::orc::JITTargetMachineBuilder::detectHost());
+        JTMB.setRelocationModel(llvm::Reloc::PIC_);
+        auto TM = throwOnError(JTMB.createTargetMachine());
+
+        module->setDataLayout(TM->createDataLayout());
+        module->setTargetTriple(TM->getTargetTriple().str());
+
+        // passes look runtime functions up by their x names, so they are renamed afterwards
+        OptimizationTransform(mangler, gc).run(*module);
+        renameBuiltins(*module, runtime);
+        defineProgram(*module, builder, *mangler, *gc);
+
+        std::string buf;
+        llvm::raw_string_ostream os(buf);
+        if (llvm::verifyModule(*module, &os)) {
+            throw ExecutableEmitterException(os.str());
+        }
+
+        llvm::SmallString<128> objectFile;
+        if (auto ec = llvm::sys::fs::createTemporaryFile("x", "o", objectFile)) {
+            throw ExecutableEmitterException("couldn't create object file: " + ec.message());
+        }
+
+        try {
+            emitObject(*module, *TM, objectFile.str().str());
+            link(objectFile.str().str());
+        } catch (...) {
+            llvm::sys::fs::remove(objectFile);
+            throw;
+        }
+
+        llvm::sys::fs::remove(objectFile);
+
+        return node;
+    }
+
+    void ExecutableEmitter::renameBuiltins(llvm::Module &module, Runtime::Runtime &runtime) const {
+        for (auto &builtin: runtime.getBuiltins()) {
+            auto fn = module.getFunction(builtin.name);
+            if (!fn) {
+                continue;
+            }
+
+            // llvm adds suffix to the name if it's taken
+            fn->setName(builtin.symbol);
+            if (fn->getName() != builtin.symbol) {
+                throw ExecutableEmitterException("symbol " + builtin.symbol + " is reserved by the runtime");
+            }
+        }
+    }
+
+    void ExecutableEmitter::defineProgram(llvm::Module &module, llvm::IRBuilder<> &builder, Mangler &mangler, GC::GC &gc) const {
+        auto ptrType = builder.getPtrTy();
+        auto int64Type = builder.getInt64Ty();
+        auto null = llvm::ConstantPointerNull::get(ptrType);
+
+        auto storageType = llvm::ArrayType::get(builder.getInt8Ty(), sizeof(GC::Metadata));
+        std::unordered_map<const GC::Metadata *, llvm::Constant *> metaValues;
+        auto replaceDecl = [&](const std::string &symbol, llvm::GlobalVariable *value) {
+            if (auto decl = module.getNamedGlobal(symbol)) {
+                decl->replaceAllUsesWith(value);
+                decl->eraseFromParent();
+            }
+        };
+
+        // string meta is defined by the runtime library
+        auto stringMeta = GC::GC::getStringMeta();
+        auto stringMetaValue = new llvm::GlobalVariable(module, storageType, false, llvm::GlobalValue::ExternalLinkage, nullptr);
+        replaceDecl(mangler.mangleGCMeta(stringMeta->name), stringMetaValue);
+        stringMetaValue->setName(GC::STRING_META_SYMBOL);
+        metaValues[stringMeta] = stringMetaValue;
+
+        // storage of other metas is constructed at startup. unnamed metas and metas whose name was taken by another meta
+        // can't be referred to by code, but they could be referred to by other metas
+        std::vector<std::pair<const GC::Metadata *, llvm::GlobalVariable *>> storages;
+        auto &namedMetas = gc.getNamedMetas();
+
+        for (auto meta: gc.getMetas()) {
+            auto storage = new llvm::GlobalVariable(module, storageType, false, llvm::GlobalValue::InternalLinkage,
+                                                    llvm::ConstantAggregateZero::get(storageType), mangler.mangleInternalSymbol("gcMeta"));
+            storage->setAlignment(llvm::Align(alignof(GC::Metadata)));
+
+            auto namedMeta = namedMetas.find(meta->name);
+            if (!meta->name.empty() && namedMeta != namedMetas.end() && namedMeta->second == meta) {
+                auto symbol = mangler.mangleGCMeta(meta->name);
+                replaceDecl(symbol, storage);
+                storage->setName(symbol);
+            }
+
+            metaValues[meta] = storage;
+            storages.emplace_back(meta, storage);
+        }
+
+        // code must not refer to metas which aren't described
+        auto metaPrefix = mangler.mangleGCMeta("");
+        for (auto &var: module.globals()) {
+            if (var.isDeclaration() && var.getName().starts_with(metaPrefix)) {
+                throw ExecutableEmitterException("unknown gc meta " + var.getName().str());
+            }
+        }
+
+        // {offset, meta} (see MetaDescriptor::Pointer)
+        auto pointerType = llvm::StructType::get(int64Type, ptrType);
+        // {storage, type, name, pointers, pointersCount} (see MetaDescriptor)
+        auto descriptorType = llvm::StructType::get(ptrType, int64Type, ptrType, ptrType, int64Type);
+        std::vector<llvm::Constant *> descriptors;
+
+        for (auto &[meta, storage]: storages) {
+            std::vector<llvm::Constant *> pointers;
+            for (auto &[offset, pointerMeta]: meta->pointerList) {
+                llvm::Constant *pointerMetaValue = null;
+                if (pointerMeta) {
+                    auto it = metaValues.find(pointerMeta);
+                    if (it == metaValues.end()) {
+                        throw ExecutableEmitterException("gc meta " + meta->name + " refers to unknown meta " + pointerMeta->name);
+                    }
+                    pointerMetaValue = it->second;
+                }
+                pointers.push_back(llvm::ConstantStruct::get(pointerType, {builder.getInt64(offset), pointerMetaValue}));
+            }
+
+            llvm::Constant *pointersValue = null;
+            if (!pointers.empty()) {
+                auto pointersType = llvm::ArrayType::get(pointerType, pointers.size());
+                pointersValue = new llvm::GlobalVariable(module, pointersType, true, llvm::GlobalValue::InternalLinkage,
+                                                         llvm::ConstantArray::get(pointersType, pointers), storage->getName() + ".pointers");
+            }
+
+            auto nameValue = builder.CreateGlobalStringPtr(meta->name, storage->getName() + ".name", 0, &module);
+
+            descriptors.push_back(llvm::ConstantStruct::get(descriptorType, {
+                    storage, builder.getInt64((int64_t)meta->type), nameValue, pointersValue, builder.getInt64(pointers.size())}));
+        }
+
+        auto descriptorsType = llvm::ArrayType::get(descriptorType, descriptors.size());
+        auto descriptorsValue = new llvm::GlobalVariable(module, descriptorsType, true, llvm::GlobalValue::InternalLinkage,
+                                                         llvm::ConstantArray::get(descriptorsType, descriptors),
+                                                         mangler.mangleInternalSymbol("gcMetas"));
+
+        // runtime library defines c main, which starts x main
+        auto mainFn = module.getFunction(Codegen::Codegen::MAIN_FN_NAME);
+        if (!mainFn) {
+            throw ExecutableEmitterException("main function is not defined");
+        }
+        mainFn->setName(mangler.mangleInternalFunction(Codegen::Codegen::MAIN_FN_NAME));
+
+        llvm::Constant *initFn = module.getFunction(mangler.mangleInternalFunction(Codegen::Codegen::INIT_FN_NAME));
+        if (!initFn) {
+            initFn = null;
+        }
+
+        // {gc, stackTop, init, main, metas, metasCount} (see Program)
+        auto programType = llvm::StructType::get(ptrType, ptrType, ptrType, ptrType, ptrType, int64Type);
+        new llvm::GlobalVariable(module, programType, true, llvm::GlobalValue::ExternalLinkage, llvm::ConstantStruct::get(programType, {
+                module.getNamedGlobal(mangler.mangleInternalSymbol("gc")),
+                module.getNamedGlobal(mangler.mangleInternalSymbol("gcStackTop")),
+                initFn,
+                mainFn,
+                descriptorsValue,
+                builder.getInt64(descriptors.size()),
+        }), Runtime::Program::SYMBOL);
+    }
+
+    void ExecutableEmitter::emitObject(llvm::Module &module, llvm::TargetMachine &TM, const std::string &objectFile) const {
+        std::error_code ec;
+        llvm::raw_fd_ostream os(objectFile, ec, llvm::sys::fs::OF_None);
+        if (ec) {
+            throw ExecutableEmitterException("couldn't open " + objectFile + ": " + ec.message());
+        }
+
+        llvm::legacy::PassManager PM;
+        if (TM.addPassesToEmitFile(PM, os, nullptr, llvm::CodeGenFileType::ObjectFile)) {
+            throw ExecutableEmitterException("target can't emit object file");
+        }
+
+        PM.run(module);
+        os.flush();
+    }
+
+    std::string ExecutableEmitter::findRuntimeLib() const {
+        if (auto lib = std::getenv("X_RUNTIME_LIB")) {
+            return lib;
+        }
+
+        // next to the compiler (build tree) or in lib dir of the installation (see install rules in CMakeLists.txt)
+        auto executable = llvm::sys::fs::getMainExecutable(nullptr, reinterpret_cast<void *>(&std::getenv));
+        if (!executable.empty()) {
+            auto dir = llvm::sys::path::parent_path(executable);
+
+            for (auto libDir: {dir.str(), (dir + "/../lib").str()}) {
+                llvm::SmallString<128> lib(libDir);
+                llvm::sys::path::append(lib, X_RUNTIME_LIB_NAME);
+                if (llvm::sys::fs::exists(lib)) {
+                    return lib.str().str();
+                }
+            }
+        }
+
+        if (llvm::sys::fs::exists(X_RUNTIME_LIB)) {
+            return X_RUNTIME_LIB;
+        }
+
+        throw ExecutableEmitterException("runtime library " + std::string(X_RUNTIME_LIB_NAME) + " is not found, set X_RUNTIME_LIB");
+    }
+
+    void ExecutableEmitter::link(const std::string &objectFile) const {
+        auto quote = [](const std::string &s) {
+            std::string res = "'";
+            for (auto c: s) {
+                res += c == '\'' ? std::string("'\\''") : std::string(1, c);
+            }
+            return res + "'";
+        };
+
+        // runtime library is written in c++, so it's linked by c++ driver
+        auto linker = std::getenv("CXX");
+        auto command = std::string(linker ? linker : "c++") + ' ' + quote(objectFile) + ' ' + quote(findRuntimeLib()) +
+                       " -lpthread -o " + quote(outputFile);
+
+        auto status = std::system(command.c_str());
+        if (status == -1) {
+            throw ExecutableEmitterException("couldn't run linker: " + std::string(std::strerror(errno)));
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            auto reason = WIFEXITED(status) ? "exit code " + std::to_string(WEXITSTATUS(status)) : std::string("signal");
+            throw ExecutableEmitterException("couldn't link " + outputFile + ", linker failed with " + reason + ": " + command);
+        }
+    }
+
+    template<typename T>
+    T ExecutableEmitter::throwOnError(llvm::Expected<T> &&val) const {
+        if (auto err = val.takeError()) {
+            throw ExecutableEmitterException(llvm::toString(std::move(err)));
+        }
+        return std::move(*val);
+    }
+}
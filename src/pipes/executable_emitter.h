@@ -0,0 +1,53 @@
+#pragma once
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Target/TargetMachine.h"
+
+#include "pipeline.h"
+#include "mangler.h"
+#include "compiler_runtime.h"
+#include "runtime/runtime.h"
+#include "gc/gc.h"
+
+namespace X::Pipes {
+    // compiles program ahead of time and links it with the runtime library into native executable
+    class ExecutableEmitter : public Pipe {
+        std::shared_ptr<CompilerRuntime> compilerRuntime;
+        std::string sourceName;
+        std::string outputFile;
+
+    public:
+        ExecutableEmitter(std::shared_ptr<CompilerRuntime> compilerRuntime, std::string sourceName, std::string outputFile) :
+                compilerRuntime(std::move(compilerRuntime)), sourceName(std::move(sourceName)), outputFile(std::move(outputFile)) {}
+
+        TopStatementListNode *handle(TopStatementListNode *node) override;
+
+    private:
+        // runtime functions are linked by their c names
+        void renameBuiltins(llvm::Module &module, Runtime::Runtime &runtime) const;
+        // metas exist only in the compiler, so the executable reserves storage for them and describes how to construct them
+        // (see Runtime::Program)
+        void defineProgram(llvm::Module &module, llvm::IRBuilder<> &builder, Mangler &mangler, GC::GC &gc) const;
+        void emitObject(llvm::Module &module, llvm::TargetMachine &TM, const std::string &objectFile) const;
+        // X_RUNTIME_LIB env variable overrides the library found relative to the compiler
+        std::string findRuntimeLib() const;
+        void link(const std::string &objectFile) const;
+
+        template<typename T>
+        T throwOnError(llvm::Expected<T> &&val) const;
+    };
+
+    class ExecutableEmitterException : public std::exception {
+        std::string message;
+
+    public:
+        ExecutableEmitterException(const char *m) : message(m) {}
+        ExecutableEmitterException(std::string s) : message(std::move(s)) {}
+
+        const char *what() const noexcept override {
+            return message.c_str();
+        }
+    };
+}
@@ -0,0 +1,38 @@
+#include <new>
+
+#include "program.h"
+
+// defined by the compiler in the executable (see Program::SYMBOL)
+extern "C" const X::Runtime::Program x_program;
+
+int main() {
+    using namespace X;
+
+    auto &program = x_program;
+    GC::GC gc;
+
+    for (int64_t i = 0; i < program.metasCount; i++) {
+        auto &desc = program.metas[i];
+        GC::PointerList pointerList;
+        for (int64_t j = 0; j < desc.pointersCount; j++) {
+            pointerList.emplace_back(desc.pointers[j].offset, desc.pointers[j].meta);
+        }
+
+        new(desc.storage) GC::Metadata{(GC::NodeType)desc.type, std::move(pointerList), desc.name};
+    }
+
+    *program.gc = &gc;
+    gc.setStackTop(program.stackTop);
+
+    if (program.init) {
+        program.init();
+    }
+
+    program.main();
+
+    for (int64_t i = 0; i < program.metasCount; i++) {
+        program.metas[i].storage->~Metadata();
+    }
+
+    return 0;
+}
@@ -25,8 +25,7 @@ namespace X::Runtime {
         }
     }
 
-    llvm::StructType *ArrayRuntime::add(const Type &arrType, llvm::Type *elemLlvmType) {
-        const auto &arrayTypeName = getClassName(arrType);
+    llvm::StructType *ArrayRuntime::add(const std::string &arrayTypeName, llvm::Type *elemLlvmType) {
         auto arrLlvmType = llvm::StructType::create(
                 context,
                 // data pointer, length, capacity
@@ -47,7 +46,7 @@ namespace X::Runtime {
     void ArrayRuntime::addConstructor(llvm::StructType *arrayType, llvm::Type *elemType) {
         auto fnType = llvm::FunctionType::get(
                 llvm::Type::getVoidTy(context),
-                {llvm::PointerType::get(context, 0), llvm::Type::getInt64Ty(context)},
+                {llvm::PointerType::get(context, 0), llvm::Type::getInt64Ty(context), llvm::Type::getInt64Ty(context)},
                 false
         );
         auto fn = llvm::Function::Create(fnType, llvm::Function::ExternalLinkage,
@@ -55,9 +54,11 @@ namespace X::Runtime {
 
         auto that = fn->getArg(0);
         auto len = fn->getArg(1);
+        auto inlineCap = fn->getArg(2);
 
         that->setName(THIS_KEYWORD);
         len->setName("len");
+        inlineCap->setName("inline_cap");
 
         auto bb = llvm::BasicBlock::Create(context, "entry", fn);
         llvm::IRBuilder<> builder(&fn->getEntryBlock(), fn->getEntryBlock().begin());
@@ -78,7 +79,22 @@ namespace X::Runtime {
         auto lenPtr = builder.CreateStructGEP(arrayType, that, 1);
         builder.CreateStore(len, lenPtr);
 
+        // elements of small arrays are allocated together with the array (see Codegen::newArray)
+        auto inlineDataBB = llvm::BasicBlock::Create(context, "inline_data");
+        auto checkCapBB = llvm::BasicBlock::Create(context, "check_cap");
+        cond = builder.CreateICmpSGT(inlineCap, builder.getInt64(0));
+        builder.CreateCondBr(cond, inlineDataBB, checkCapBB);
+
+        fn->insert(fn->end(), inlineDataBB);
+        builder.SetInsertPoint(inlineDataBB);
+        builder.CreateStore(inlineCap, builder.CreateStructGEP(arrayType, that, 2));
+        auto inlineData = builder.CreateGEP(builder.getInt8Ty(), that, getTypeSize(module, arrayType));
+        builder.CreateStore(inlineData, builder.CreateStructGEP(arrayType, that, 0));
+        builder.CreateRetVoid();
+
         // check cap
+        fn->insert(fn->end(), checkCapBB);
+        builder.SetInsertPoint(checkCapBB);
         auto setCapBB = llvm::BasicBlock::Create(context, "set_cap");
         auto growCapBB = llvm::BasicBlock::Create(context, "grow_cap");
         auto minCap = builder.getInt64(ArrayRuntime::MIN_CAP);
@@ -100,14 +116,20 @@ namespace X::Runtime {
 
         // alloc
 
-        auto allocFn = module.getFunction(mangler->mangleInternalFunction("gcAlloc"));
+        // elements beyond len are never read, so data isn't zeroed
+        auto allocFn = module.getFunction(mangler->mangleInternalFunction("gcAllocUninitialized"));
         auto gcVar = module.getGlobalVariable(mangler->mangleInternalSymbol("gc"));
         auto elemTypeSize = getTypeSize(module, elemType);
         auto allocSize = builder.CreateMul(cap, elemTypeSize);
-        auto arr = builder.CreateCall(allocFn, {gcVar, allocSize});
+        // array data has no gc meta, it's traced through array
+        auto arr = builder.CreateCall(allocFn, {gcVar, allocSize, llvm::ConstantPointerNull::get(builder.getPtrTy())});
         auto arrPtr = builder.CreateStructGEP(arrayType, that, 0);
         builder.CreateStore(arr, arrPtr);
 
+        // array could be promoted to old generation while data was allocated
+        auto writeBarrierFn = module.getFunction(mangler->mangleInternalFunction("gcWriteBarrier"));
+        builder.CreateCall(writeBarrierFn, {gcVar, that});
+
         builder.CreateRetVoid();
 
         // invalid len error
@@ -293,11 +315,29 @@ namespace X::Runtime {
         auto newCap = builder.CreateShl(cap, 1);
         builder.CreateStore(newCap, capPtr);
 
-        auto reallocFn = module.getFunction(mangler->mangleInternalFunction("gcRealloc"));
         auto gcVar = module.getGlobalVariable(mangler->mangleInternalSymbol("gc"));
         auto elemTypeSize = getTypeSize(module, elemType);
         auto allocSize = builder.CreateMul(newCap, elemTypeSize);
-        auto newArr = builder.CreateCall(reallocFn, {gcVar, arr, allocSize});
+
+        // inline elements are moved out of the array, they can't be reallocated
+        auto moveInlineDataBB = llvm::BasicBlock::Create(context, "move_inline_data");
+        auto reallocBB = llvm::BasicBlock::Create(context, "realloc");
+        auto inlineData = builder.CreateGEP(builder.getInt8Ty(), that, getTypeSize(module, arrayType));
+        cond = builder.CreateICmpEQ(arr, inlineData);
+        builder.CreateCondBr(cond, moveInlineDataBB, reallocBB);
+
+        fn->insert(fn->end(), moveInlineDataBB);
+        builder.SetInsertPoint(moveInlineDataBB);
+        auto allocFn = module.getFunction(mangler->mangleInternalFunction("gcAllocUninitialized"));
+        auto newArr = builder.CreateCall(allocFn, {gcVar, allocSize, llvm::ConstantPointerNull::get(builder.getPtrTy())});
+        builder.CreateMemCpy(newArr, llvm::MaybeAlign(), arr, llvm::MaybeAlign(), builder.CreateMul(cap, elemTypeSize));
+        builder.CreateStore(newArr, arrPtr);
+        builder.CreateBr(appendBB);
+
+        fn->insert(fn->end(), reallocBB);
+        builder.SetInsertPoint(reallocBB);
+        auto reallocFn = module.getFunction(mangler->mangleInternalFunction("gcRealloc"));
+        newArr = builder.CreateCall(reallocFn, {gcVar, arr, allocSize});
         builder.CreateStore(newArr, arrPtr);
         builder.CreateBr(appendBB);
 
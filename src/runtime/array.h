@@ -19,12 +19,16 @@ namespace X::Runtime {
 
     public:
         static inline const std::string CLASS_NAME = "Array";
+        // arrays of interface values ({obj ptr, vtable} pairs)
+        static inline const std::string INTERFACE_CLASS_NAME = CLASS_NAME + ".interface";
         static inline const int MIN_CAP = 8;
+        // arrays up to this size (header included) keep their elements inline
+        static inline const int MAX_INLINE_SIZE = 256;
 
         ArrayRuntime(llvm::LLVMContext &context, llvm::Module &module, std::shared_ptr<Mangler> mangler) :
                 context(context), module(module), mangler(std::move(mangler)) {}
 
-        llvm::StructType *add(const Type &type, llvm::Type *llvmType);
+        llvm::StructType *add(const std::string &arrayTypeName, llvm::Type *llvmType);
 
         static std::string getClassName(const Type &type);
 
@@ -37,13 +41,6 @@ namespace X::Runtime {
         void addAppend(llvm::StructType *arrayType, llvm::Type *elemType);
     };
 
-    template<typename T>
-    struct Array {
-        T *data;
-        int64_t len;
-        int64_t cap;
-    };
-
     class InvalidArrayTypeException : public std::exception {
     public:
         const char *what() const noexcept override {
@@ -0,0 +1,49 @@
+#include "builtins.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "gc/gc.h"
+
+namespace X::Runtime {
+    void die(const char *s) {
+        std::cout << s << std::endl;
+        std::exit(1);
+    }
+
+    bool compareStrings(String *first, String *second) {
+        return first->len == second->len && std::strncmp(first->str, second->str, first->len) == 0;
+    }
+
+    void *gc_alloc(GC::GC **gc, std::size_t size, GC::Metadata *meta) {
+        try {
+            return (*gc)->alloc(size, meta);
+        } catch (const GC::OutOfMemoryException &e) {
+            die(e.what());
+        }
+    }
+
+    void *gc_allocUninitialized(GC::GC **gc, std::size_t size, GC::Metadata *meta) {
+        try {
+            return (*gc)->allocUninitialized(size, meta);
+        } catch (const GC::OutOfMemoryException &e) {
+            die(e.what());
+        }
+    }
+
+    void *gc_realloc(GC::GC **gc, void *ptr, std::size_t newSize) {
+        try {
+            return (*gc)->realloc(ptr, newSize);
+        } catch (const GC::OutOfMemoryException &e) {
+            die(e.what());
+        }
+    }
+
+    void gc_addGlobalRoot(GC::GC **gc, void **root, GC::Metadata *meta) {
+        (*gc)->addGlobalRoot(root, meta);
+    }
+
+    void gc_writeBarrier(GC::GC **gc, void *obj) {
+        (*gc)->writeBarrier(obj);
+    }
+}
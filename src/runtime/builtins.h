@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+#include "runtime/string.h"
+
+namespace X::GC {
+    class GC;
+    struct Metadata;
+}
+
+namespace X::Runtime {
+    // builtins have c linkage, so aot compiled code is linked with them by name (see Runtime::getBuiltins)
+    extern "C" {
+    [[noreturn]] void die(const char *s);
+
+    /// returns true is stings are equal
+    bool compareStrings(String *first, String *second);
+
+    // exceptions can't be thrown through compiled code
+    void *gc_alloc(GC::GC **gc, std::size_t size, GC::Metadata *meta);
+    void *gc_allocUninitialized(GC::GC **gc, std::size_t size, GC::Metadata *meta);
+    void *gc_realloc(GC::GC **gc, void *ptr, std::size_t newSize);
+    void gc_addGlobalRoot(GC::GC **gc, void **root, GC::Metadata *meta);
+    void gc_writeBarrier(GC::GC **gc, void *obj);
+    }
+}
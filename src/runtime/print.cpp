@@ -4,7 +4,7 @@
 #include <iostream>
 
 #include "string.h"
-#include "utils.h"
+#include "builtins.h"
 
 namespace X::Runtime {
     void print(Type::TypeID typeId, ...) {
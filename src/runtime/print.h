@@ -1,13 +1,22 @@
 #pragma once
 
+#include <cstdint>
+
 #include "type.h"
-#include "array.h"
 
 namespace X::Runtime {
-    void print(Type::TypeID typeId, ...);
+    // layout of runtime arrays (see GC::ArrayHeader)
+    template<typename T>
+    struct Array {
+        T *data;
+        int64_t len;
+        int64_t cap;
+    };
+
+    extern "C" void print(Type::TypeID typeId, ...);
 
     template<typename T>
     void printArray(Type::TypeID subtypeId, Array<T> *arr);
 
-    void printNewline();
+    extern "C" void printNewline();
 }
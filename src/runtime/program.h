@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "gc/gc.h"
+
+namespace X::Runtime {
+    // gc meta of aot compiled program. metas are created by the compiler, so they are described in the executable
+    // and constructed at startup in the storage reserved for them (compiled code refers to the storage)
+    struct MetaDescriptor {
+        struct Pointer {
+            int64_t offset;
+            GC::Metadata *meta;
+        };
+
+        GC::Metadata *storage;
+        int64_t type; // GC::NodeType
+        const char *name;
+        const Pointer *pointers;
+        int64_t pointersCount;
+    };
+
+    // aot compiled program (see Pipes::ExecutableEmitter), runtime library starts it from main
+    struct Program {
+        static inline const std::string SYMBOL = "x_program";
+
+        GC::GC **gc;
+        GC::StackFrame **stackTop;
+        void (*init)(); // could be null
+        void (*main)();
+        const MetaDescriptor *metas;
+        int64_t metasCount;
+    };
+}
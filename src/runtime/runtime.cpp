@@ -8,43 +8,14 @@
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 
-#include "gc/gc.h"
+#include "builtins.h"
 #include "print.h"
 #include "mangler.h"
-#include "utils.h"
 
 namespace X::Runtime {
-    /// returns true is stings are equal
-    bool compareStrings(String *first, String *second) {
-        return first->len == second->len && std::strncmp(first->str, second->str, first->len) == 0;
-    }
-
-    void *gc_alloc(GC::GC **gc, std::size_t size) {
-        return (*gc)->alloc(size);
-    }
-
-    void *gc_realloc(GC::GC **gc, void *ptr, std::size_t newSize) {
-        return (*gc)->realloc(ptr, newSize);
-    }
-
-    void gc_pushStackFrame(GC::GC **gc) {
-        (*gc)->pushStackFrame();
-    }
-
-    void gc_popStackFrame(GC::GC **gc) {
-        (*gc)->popStackFrame();
-    }
-
-    void gc_addRoot(GC::GC **gc, void **root, GC::Metadata *meta) {
-        (*gc)->addRoot(root, meta);
-    }
-
-    void gc_addGlobalRoot(GC::GC **gc, void **root, GC::Metadata *meta) {
-        (*gc)->addGlobalRoot(root, meta);
-    }
-
     void Runtime::addDeclarations(llvm::LLVMContext &context, llvm::IRBuilder<> &builder, llvm::Module &module) {
-        llvm::StructType::create(context, {builder.getPtrTy(), builder.getInt64Ty()}, String::CLASS_NAME);
+        // length, chars are stored right after it
+        llvm::StructType::create(context, {builder.getInt64Ty()}, String::CLASS_NAME);
 
         // print is special (varg)
         module.getOrInsertFunction(mangler->mangleInternalFunction("print"), llvm::FunctionType::get(builder.getVoidTy(), {builder.getInt64Ty()}, true));
@@ -59,28 +30,27 @@ namespace X::Runtime {
 
                 // string
                 {mangler->mangleInternalFunction("compareStrings"), builder.getInt1Ty(), {builder.getPtrTy(), builder.getPtrTy()}},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, CONSTRUCTOR_FN_NAME), builder.getVoidTy(), {builder.getPtrTy(), builder.getPtrTy()}},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "concat"), builder.getPtrTy(), {builder.getPtrTy(), builder.getPtrTy()}},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "length"), builder.getInt64Ty(), {builder.getPtrTy()}},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "isEmpty"), builder.getInt1Ty(), {builder.getPtrTy()}},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "trim"), builder.getPtrTy(), {builder.getPtrTy()}},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "toLower"), builder.getPtrTy(), {builder.getPtrTy()}},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "toUpper"), builder.getPtrTy(), {builder.getPtrTy()}},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "index"), builder.getInt64Ty(), {builder.getPtrTy(), builder.getPtrTy()}},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "contains"), builder.getInt1Ty(), {builder.getPtrTy(), builder.getPtrTy()}},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "startsWith"), builder.getInt1Ty(), {builder.getPtrTy(), builder.getPtrTy()}},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "endsWith"), builder.getInt1Ty(), {builder.getPtrTy(), builder.getPtrTy()}},
+                {mangler->mangleInternalFunction("createString"), builder.getPtrTy(), {builder.getPtrTy(), builder.getPtrTy(), builder.getInt64Ty()}},
+                {mangler->mangleInternalMethod(String::CLASS_NAME, "concat"), builder.getPtrTy(), {builder.getPtrTy(), builder.getPtrTy(), builder.getPtrTy()}},
+                {mangler->mangleInternalMethod(String::CLASS_NAME, "length"), builder.getInt64Ty(), {builder.getPtrTy(), builder.getPtrTy()}},
+                {mangler->mangleInternalMethod(String::CLASS_NAME, "isEmpty"), builder.getInt1Ty(), {builder.getPtrTy(), builder.getPtrTy()}},
+                {mangler->mangleInternalMethod(String::CLASS_NAME, "trim"), builder.getPtrTy(), {builder.getPtrTy(), builder.getPtrTy()}},
+                {mangler->mangleInternalMethod(String::CLASS_NAME, "toLower"), builder.getPtrTy(), {builder.getPtrTy(), builder.getPtrTy()}},
+                {mangler->mangleInternalMethod(String::CLASS_NAME, "toUpper"), builder.getPtrTy(), {builder.getPtrTy(), builder.getPtrTy()}},
+                {mangler->mangleInternalMethod(String::CLASS_NAME, "index"), builder.getInt64Ty(), {builder.getPtrTy(), builder.getPtrTy(), builder.getPtrTy()}},
+                {mangler->mangleInternalMethod(String::CLASS_NAME, "contains"), builder.getInt1Ty(), {builder.getPtrTy(), builder.getPtrTy(), builder.getPtrTy()}},
+                {mangler->mangleInternalMethod(String::CLASS_NAME, "startsWith"), builder.getInt1Ty(), {builder.getPtrTy(), builder.getPtrTy(), builder.getPtrTy()}},
+                {mangler->mangleInternalMethod(String::CLASS_NAME, "endsWith"), builder.getInt1Ty(), {builder.getPtrTy(), builder.getPtrTy(), builder.getPtrTy()}},
                 {mangler->mangleInternalMethod(String::CLASS_NAME, "substring"), builder.getPtrTy(),
-                 {builder.getPtrTy(), builder.getInt64Ty(), builder.getInt64Ty()}},
-                {mangler->mangleInternalFunction("createEmptyString"), builder.getPtrTy(), {}},
+                 {builder.getPtrTy(), builder.getPtrTy(), builder.getInt64Ty(), builder.getInt64Ty()}},
+                {mangler->mangleInternalFunction("createEmptyString"), builder.getPtrTy(), {builder.getPtrTy()}},
 
                 // gc
-                {mangler->mangleInternalFunction("gcAlloc"), builder.getPtrTy(), {builder.getPtrTy(), builder.getInt64Ty()}},
+                {mangler->mangleInternalFunction("gcAlloc"), builder.getPtrTy(), {builder.getPtrTy(), builder.getInt64Ty(), builder.getPtrTy()}},
+                {mangler->mangleInternalFunction("gcAllocUninitialized"), builder.getPtrTy(), {builder.getPtrTy(), builder.getInt64Ty(), builder.getPtrTy()}},
                 {mangler->mangleInternalFunction("gcRealloc"), builder.getPtrTy(), {builder.getPtrTy(), builder.getPtrTy(), builder.getInt64Ty()}},
-                {mangler->mangleInternalFunction("gcPushStackFrame"), builder.getVoidTy(), {builder.getPtrTy()}},
-                {mangler->mangleInternalFunction("gcPopStackFrame"), builder.getVoidTy(), {builder.getPtrTy()}},
-                {mangler->mangleInternalFunction("gcAddRoot"), builder.getPtrTy(), {builder.getPtrTy(), builder.getPtrTy(), builder.getPtrTy()}},
                 {mangler->mangleInternalFunction("gcAddGlobalRoot"), builder.getPtrTy(), {builder.getPtrTy(), builder.getPtrTy(), builder.getPtrTy()}},
+                {mangler->mangleInternalFunction("gcWriteBarrier"), builder.getVoidTy(), {builder.getPtrTy(), builder.getPtrTy()}},
         };
 
         for (auto &[fnName, retType, paramTypes]: funcs) {
@@ -91,46 +61,60 @@ namespace X::Runtime {
         auto gc = llvm::cast<llvm::GlobalVariable>(
                 module.getOrInsertGlobal(mangler->mangleInternalSymbol("gc"), builder.getPtrTy()));
         gc->setInitializer(llvm::ConstantPointerNull::get(builder.getPtrTy()));
+
+        // top of the shadow stack (see GC::StackFrame)
+        auto gcStackTop = llvm::cast<llvm::GlobalVariable>(
+                module.getOrInsertGlobal(mangler->mangleInternalSymbol("gcStackTop"), builder.getPtrTy()));
+        gcStackTop->setInitializer(llvm::ConstantPointerNull::get(builder.getPtrTy()));
+
+        // source line of the current statement (see GC::Options::profileAllocations)
+        auto gcAllocSite = llvm::cast<llvm::GlobalVariable>(
+                module.getOrInsertGlobal(mangler->mangleInternalSymbol("gcAllocSite"), builder.getInt64Ty()));
+        gcAllocSite->setInitializer(builder.getInt64(0));
     }
 
-    void Runtime::addDefinitions(llvm::orc::JITDylib &JD, llvm::orc::MangleAndInterner &llvmMangler) {
-        static std::vector<std::tuple<std::string, void *>> funcs{
-                {mangler->mangleInternalFunction("die"), reinterpret_cast<void *>(die)},
-                {"exit", reinterpret_cast<void *>(std::exit)},
+    std::vector<Builtin> Runtime::getBuiltins() const {
+        // symbol is the name of c function
+#define BUILTIN(name, fn) Builtin{name, #fn, reinterpret_cast<void *>(fn)}
+        return {
+                BUILTIN(mangler->mangleInternalFunction("die"), die),
+                BUILTIN("exit", exit),
 
                 // print
-                {mangler->mangleInternalFunction("print"), reinterpret_cast<void *>(print)},
-                {mangler->mangleInternalFunction("printNewline"), reinterpret_cast<void *>(printNewline)},
+                BUILTIN(mangler->mangleInternalFunction("print"), print),
+                BUILTIN(mangler->mangleInternalFunction("printNewline"), printNewline),
 
                 // string
-                {mangler->mangleInternalFunction("compareStrings"), reinterpret_cast<void *>(compareStrings)},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, CONSTRUCTOR_FN_NAME), reinterpret_cast<void *>(String_construct)},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "concat"), reinterpret_cast<void *>(String_concat)},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "length"), reinterpret_cast<void *>(String_length)},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "isEmpty"), reinterpret_cast<void *>(String_isEmpty)},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "trim"), reinterpret_cast<void *>(String_trim)},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "toLower"), reinterpret_cast<void *>(String_toLower)},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "toUpper"), reinterpret_cast<void *>(String_toUpper)},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "index"), reinterpret_cast<void *>(String_index)},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "contains"), reinterpret_cast<void *>(String_contains)},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "startsWith"), reinterpret_cast<void *>(String_startsWith)},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "endsWith"), reinterpret_cast<void *>(String_endsWith)},
-                {mangler->mangleInternalMethod(String::CLASS_NAME, "substring"), reinterpret_cast<void *>(String_substring)},
-                {mangler->mangleInternalFunction("createEmptyString"), reinterpret_cast<void *>(createEmptyString)},
+                BUILTIN(mangler->mangleInternalFunction("compareStrings"), compareStrings),
+                BUILTIN(mangler->mangleInternalFunction("createString"), String_create),
+                BUILTIN(mangler->mangleInternalMethod(String::CLASS_NAME, "concat"), String_concat),
+                BUILTIN(mangler->mangleInternalMethod(String::CLASS_NAME, "length"), String_length),
+                BUILTIN(mangler->mangleInternalMethod(String::CLASS_NAME, "isEmpty"), String_isEmpty),
+                BUILTIN(mangler->mangleInternalMethod(String::CLASS_NAME, "trim"), String_trim),
+                BUILTIN(mangler->mangleInternalMethod(String::CLASS_NAME, "toLower"), String_toLower),
+                BUILTIN(mangler->mangleInternalMethod(String::CLASS_NAME, "toUpper"), String_toUpper),
+                BUILTIN(mangler->mangleInternalMethod(String::CLASS_NAME, "index"), String_index),
+                BUILTIN(mangler->mangleInternalMethod(String::CLASS_NAME, "contains"), String_contains),
+                BUILTIN(mangler->mangleInternalMethod(String::CLASS_NAME, "startsWith"), String_startsWith),
+                BUILTIN(mangler->mangleInternalMethod(String::CLASS_NAME, "endsWith"), String_endsWith),
+                BUILTIN(mangler->mangleInternalMethod(String::CLASS_NAME, "substring"), String_substring),
+                BUILTIN(mangler->mangleInternalFunction("createEmptyString"), createEmptyString),
 
                 // gc
-                {mangler->mangleInternalFunction("gcAlloc"), reinterpret_cast<void *>(gc_alloc)},
-                {mangler->mangleInternalFunction("gcRealloc"), reinterpret_cast<void *>(gc_realloc)},
-                {mangler->mangleInternalFunction("gcPushStackFrame"), reinterpret_cast<void *>(gc_pushStackFrame)},
-                {mangler->mangleInternalFunction("gcPopStackFrame"), reinterpret_cast<void *>(gc_popStackFrame)},
-                {mangler->mangleInternalFunction("gcAddRoot"), reinterpret_cast<void *>(gc_addRoot)},
-                {mangler->mangleInternalFunction("gcAddGlobalRoot"), reinterpret_cast<void *>(gc_addGlobalRoot)},
+                BUILTIN(mangler->mangleInternalFunction("gcAlloc"), gc_alloc),
+                BUILTIN(mangler->mangleInternalFunction("gcAllocUninitialized"), gc_allocUninitialized),
+                BUILTIN(mangler->mangleInternalFunction("gcRealloc"), gc_realloc),
+                BUILTIN(mangler->mangleInternalFunction("gcAddGlobalRoot"), gc_addGlobalRoot),
+                BUILTIN(mangler->mangleInternalFunction("gcWriteBarrier"), gc_writeBarrier),
         };
+#undef BUILTIN
+    }
 
+    void Runtime::addDefinitions(llvm::orc::JITDylib &JD, llvm::orc::MangleAndInterner &llvmMangler) {
         llvm::StringMap<void *> builtinFuncs;
 
-        for (auto &[name, ptr]: funcs) {
-            builtinFuncs[*llvmMangler(name)] = ptr;
+        for (auto &builtin: getBuiltins()) {
+            builtinFuncs[*llvmMangler(builtin.name)] = builtin.ptr;
         }
 
         JD.addGenerator(std::make_unique<RuntimeBuiltinGenerator>(std::move(builtinFuncs)));
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/IRBuilder.h"
@@ -13,6 +16,14 @@
 #include "runtime/array.h"
 
 namespace X::Runtime {
+    struct Builtin {
+        // name used by compiled code
+        std::string name;
+        // name of the function in the runtime library
+        std::string symbol;
+        void *ptr;
+    };
+
     class Runtime {
         std::shared_ptr<Mangler> mangler;
 
@@ -21,6 +32,7 @@ namespace X::Runtime {
 
         void addDeclarations(llvm::LLVMContext &context, llvm::IRBuilder<> &builder, llvm::Module &module);
         void addDefinitions(llvm::orc::JITDylib &JD, llvm::orc::MangleAndInterner &llvmMangler);
+        std::vector<Builtin> getBuiltins() const;
     };
 
     class RuntimeBuiltinGenerator : public llvm::orc::DefinitionGenerator {
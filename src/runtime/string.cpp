@@ -1,76 +1,76 @@
 #include "string.h"
 
-#include "utils.h"
+#include "gc/gc.h"
+#include "builtins.h"
 
 namespace X::Runtime {
-    String *String_new(uint64_t len) {
-        auto res = new String;
+    // callers fill the whole string, so memory isn't zeroed and only terminator is set.
+    // arguments of the caller are referenced from the stack, so they are not moved by gc.
+    // string has no pointers, its meta names it in heap census
+    String *String_new(GC::GC **gc, uint64_t len) {
+        String *res;
+        try {
+            res = (String *)(*gc)->allocUninitialized(sizeof(String) + len + 1, GC::GC::getStringMeta());
+        } catch (const GC::OutOfMemoryException &e) {
+            die(e.what());
+        }
+
         res->len = len;
-        res->str = new char[res->len + 1];
-        res->str[res->len] = 0;
+        res->str[len] = '\0';
         return res;
     }
 
-    void String_construct(String *that, const char *s) {
-        that->len = std::strlen(s);
-        that->str = new char[that->len + 1];
-        that->str[that->len] = 0;
-        std::memcpy(that->str, s, that->len);
-    }
-
-    String *String_create(const char *s) {
-        auto res = new String;
-        String_construct(res, s);
+    String *String_create(GC::GC **gc, const char *s, uint64_t len) {
+        auto res = String_new(gc, len);
+        std::memcpy(res->str, s, len);
         return res;
     }
 
-    String *String_copy(String *str) {
-        auto res = String_new(str->len);
-        std::memcpy(res->str, str->str, str->len);
-        return res;
+    String *String_copy(GC::GC **gc, String *str) {
+        return String_create(gc, str->str, str->len);
     }
 
-    String *String_concat(String *that, String *other) {
+    String *String_concat(GC::GC **gc, String *that, String *other) {
         if (!other->len) {
-            return String_copy(that);
+            return String_copy(gc, that);
         }
 
-        auto res = String_new(that->len + other->len);
+        auto res = String_new(gc, that->len + other->len);
         std::memcpy(res->str, that->str, that->len);
         std::memcpy(res->str + that->len, other->str, other->len);
         return res;
     }
 
-    uint64_t String_length(String *that) {
+    uint64_t String_length(GC::GC **gc, String *that) {
         return that->len;
     }
 
-    bool String_isEmpty(String *that) {
-        return !String_length(that);
+    bool String_isEmpty(GC::GC **gc, String *that) {
+        return !String_length(gc, that);
     }
 
-    String *String_trim(String *that) {
+    String *String_trim(GC::GC **gc, String *that) {
         if (!that->len) {
-            return String_new();
+            return String_new(gc);
         }
 
         auto startIdx = 0;
         for (; startIdx < that->len && isspace(that->str[startIdx]); startIdx++) {}
 
         if (startIdx == that->len - 1) {
-            return String_new();
+            return String_new(gc);
         }
 
         auto endIdx = that->len - 1;
         for (; endIdx > startIdx && isspace(that->str[endIdx]); endIdx--) {}
 
-        auto res = String_new(endIdx - startIdx + 1);
+        auto res = String_new(gc, endIdx - startIdx + 1);
         std::memcpy(res->str, that->str + startIdx, res->len);
         return res;
     }
 
-    String *String_toLower(String *that) {
-        auto res = String_new(that->len);
+    String *String_toLower(GC::GC **gc, String *that) {
+        auto res = String_new(gc, that->len);
 
         for (auto i = 0; i < that->len; i++) {
             res->str[i] = (char)std::tolower(that->str[i]);
@@ -79,8 +79,8 @@ namespace X::Runtime {
         return res;
     }
 
-    String *String_toUpper(String *that) {
-        auto res = String_new(that->len);
+    String *String_toUpper(GC::GC **gc, String *that) {
+        auto res = String_new(gc, that->len);
 
         for (auto i = 0; i < that->len; i++) {
             res->str[i] = (char)std::toupper(that->str[i]);
@@ -89,16 +89,16 @@ namespace X::Runtime {
         return res;
     }
 
-    int64_t String_index(String *that, String *other) {
+    int64_t String_index(GC::GC **gc, String *that, String *other) {
         auto res = std::strstr(that->str, other->str);
         return res ? res - that->str : -1;
     }
 
-    bool String_contains(String *that, String *other) {
-        return String_index(that, other) != -1;
+    bool String_contains(GC::GC **gc, String *that, String *other) {
+        return String_index(gc, that, other) != -1;
     }
 
-    bool String_startsWith(String *that, String *other) {
+    bool String_startsWith(GC::GC **gc, String *that, String *other) {
         if (other->len > that->len) {
             return false;
         }
@@ -106,7 +106,7 @@ namespace X::Runtime {
         return std::strncmp(that->str, other->str, other->len) == 0;
     }
 
-    bool String_endsWith(String *that, String *other) {
+    bool String_endsWith(GC::GC **gc, String *that, String *other) {
         if (other->len > that->len) {
             return false;
         }
@@ -114,21 +114,21 @@ namespace X::Runtime {
         return std::strncmp(that->str + that->len - other->len, other->str, other->len) == 0;
     }
 
-    String *String_substring(String *that, int64_t offset, int64_t length) {
+    String *String_substring(GC::GC **gc, String *that, int64_t offset, int64_t length) {
         if (offset < 0 || length <= 0 || offset > that->len) {
-            return String_new();
+            return String_new(gc);
         }
 
         if (length + offset > that->len) {
             length = (int64_t)that->len - offset;
         }
 
-        auto res = String_new(length);
+        auto res = String_new(gc, length);
         std::memcpy(res->str, that->str + offset, length);
         return res;
     }
 
-    String *createEmptyString() {
-        return String_new();
+    String *createEmptyString(GC::GC **gc) {
+        return String_new(gc);
     }
 }
@@ -1,32 +1,38 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
-#include "llvm/IR/Type.h"
+namespace X::GC {
+    class GC;
+}
 
 namespace X::Runtime {
+    // string is a single gc allocation, chars (with trailing zero) are stored right after the header
     struct String {
         static inline const std::string CLASS_NAME = "String";
 
-        char *str;
         uint64_t len;
+        char str[];
     };
 
-    String *String_new(uint64_t len = 0);
-    void String_construct(String *that, const char *s);
-    String *String_create(const char *s);
-    String *String_copy(String *str);
-    String *String_concat(String *that, String *other);
-    uint64_t String_length(String *that);
-    bool String_isEmpty(String *that);
-    String *String_trim(String *that);
-    String *String_toLower(String *that);
-    String *String_toUpper(String *that);
-    int64_t String_index(String *that, String *other);
-    bool String_contains(String *that, String *other);
-    bool String_startsWith(String *that, String *other);
-    bool String_endsWith(String *that, String *other);
-    String *String_substring(String *that, int64_t offset, int64_t length);
+    // string functions get gc as the first argument, because most of them create new strings
+    extern "C" {
+    String *String_new(GC::GC **gc, uint64_t len = 0);
+    String *String_create(GC::GC **gc, const char *s, uint64_t len);
+    String *String_copy(GC::GC **gc, String *str);
+    String *String_concat(GC::GC **gc, String *that, String *other);
+    uint64_t String_length(GC::GC **gc, String *that);
+    bool String_isEmpty(GC::GC **gc, String *that);
+    String *String_trim(GC::GC **gc, String *that);
+    String *String_toLower(GC::GC **gc, String *that);
+    String *String_toUpper(GC::GC **gc, String *that);
+    int64_t String_index(GC::GC **gc, String *that, String *other);
+    bool String_contains(GC::GC **gc, String *that, String *other);
+    bool String_startsWith(GC::GC **gc, String *that, String *other);
+    bool String_endsWith(GC::GC **gc, String *that, String *other);
+    String *String_substring(GC::GC **gc, String *that, int64_t offset, int64_t length);
 
-    String *createEmptyString();
+    String *createEmptyString(GC::GC **gc);
+    }
 }
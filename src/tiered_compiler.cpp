@@ -0,0 +1,255 @@
+#include "tiered_compiler.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include "utils.h"
+#include "codegen/codegen.h"
+#include "pipes/code_generator.h"
+
+namespace X {
+    TieredCompiler::~TieredCompiler() {
+        {
+            std::lock_guard lock(mutex);
+            stopped = true;
+        }
+        cv.notify_all();
+
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    llvm::Error TieredCompiler::addModule(llvm::orc::ThreadSafeModule TSM) {
+        TSM.withModuleDo([&](llvm::Module &module) {
+            module.setDataLayout(jitter.getDataLayout());
+            module.setTargetTriple(jitter.getTargetTriple().str());
+
+            // locals are shared by both tiers
+            externalizeLocals(module, mangler->mangleInternalSymbol("local"));
+
+            // only user functions are recompiled. main runs once, internal functions (init, array methods and so on)
+            // are small and get inlined into the second tier of their callers anyway
+            for (auto &fn: module) {
+                auto name = fn.getName().str();
+                if (!fn.isDeclaration() && name != Codegen::Codegen::MAIN_FN_NAME && !mangler->isInternalSymbol(name)) {
+                    functions.push_back(name);
+                }
+            }
+
+            llvm::raw_svector_ostream os(bitcode);
+            llvm::WriteBitcodeToFile(module, os);
+
+            instrument(module);
+            redirectToStubs(module);
+        });
+
+        stubs = llvm::orc::createLocalIndirectStubsManagerBuilder(jitter.getTargetTriple())();
+
+        // stubs are pointed to the first tier when it's compiled (see start)
+        llvm::orc::IndirectStubsManager::StubInitsMap inits;
+        for (auto &name: functions) {
+            inits[name] = {llvm::orc::ExecutorAddr(), llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable};
+        }
+
+        if (auto err = stubs->createStubs(inits)) {
+            return err;
+        }
+
+        llvm::orc::SymbolMap symbols;
+        for (auto &name: functions) {
+            symbols[jitter.mangleAndIntern(name)] = stubs->findStub(name, true);
+        }
+
+        symbols[jitter.mangleAndIntern(mangler->mangleInternalSymbol("tieredCompiler"))] =
+                llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(this), llvm::JITSymbolFlags());
+        symbols[jitter.mangleAndIntern(mangler->mangleInternalFunction("tierUp"))] =
+                llvm::orc::ExecutorSymbolDef(llvm::orc::ExecutorAddr::fromPtr(reinterpret_cast<void *>(tierUp)), llvm::JITSymbolFlags());
+
+        if (auto err = jitter.getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols)))) {
+            return err;
+        }
+
+        return jitter.addIRModule(std::move(TSM));
+    }
+
+    llvm::Error TieredCompiler::start() {
+        for (auto &name: functions) {
+            auto body = jitter.lookup(name + TIER0_SUFFIX);
+            if (!body) {
+                return body.takeError();
+            }
+
+            if (auto err = stubs->updatePointer(name, *body)) {
+                return err;
+            }
+        }
+
+        thread = std::thread(&TieredCompiler::run, this);
+
+        return llvm::Error::success();
+    }
+
+    void TieredCompiler::wait() {
+        std::unique_lock lock(mutex);
+        cv.wait(lock, [&] { return stopped || (queue.empty() && !compiling); });
+    }
+
+    void TieredCompiler::tierUp(TieredCompiler *compiler, int64_t index) {
+        {
+            std::lock_guard lock(compiler->mutex);
+            compiler->queue.push_back(index);
+        }
+        // wait could be waiting on the same cv
+        compiler->cv.notify_all();
+    }
+
+    void TieredCompiler::instrument(llvm::Module &module) const {
+        auto &context = module.getContext();
+        llvm::IRBuilder<> builder(context);
+
+        auto countersType = llvm::ArrayType::get(builder.getInt64Ty(), functions.size());
+        auto counters = new llvm::GlobalVariable(module, countersType, false, llvm::GlobalValue::InternalLinkage,
+                                                 llvm::ConstantAggregateZero::get(countersType), mangler->mangleInternalSymbol("tierCounters"));
+        auto compiler = module.getOrInsertGlobal(mangler->mangleInternalSymbol("tieredCompiler"), builder.getInt8Ty());
+        auto tierUpFn = module.getOrInsertFunction(mangler->mangleInternalFunction("tierUp"), builder.getVoidTy(),
+                                                   builder.getPtrTy(), builder.getInt64Ty());
+        // function gets hot once
+        auto weights = llvm::MDBuilder(context).createBranchWeights(1, 1000);
+
+        for (std::size_t i = 0; i < functions.size(); i++) {
+            auto fn = module.getFunction(functions[i]);
+
+            // function entry (after allocas, which must stay in the entry block) and every loop iteration
+            auto entry = fn->getEntryBlock().getFirstInsertionPt();
+            while (llvm::isa<llvm::AllocaInst>(*entry)) {
+                entry++;
+            }
+
+            std::vector<llvm::Instruction *> points{&*entry};
+            llvm::DominatorTree DT(*fn);
+            llvm::LoopInfo LI(DT);
+            for (auto loop: LI.getLoopsInPreorder()) {
+                points.push_back(&*loop->getHeader()->getFirstInsertionPt());
+            }
+
+            for (auto point: points) {
+                builder.SetInsertPoint(point);
+                auto counterPtr = builder.CreateConstInBoundsGEP2_64(countersType, counters, 0, i);
+                auto count = builder.CreateAdd(builder.CreateLoad(builder.getInt64Ty(), counterPtr), builder.getInt64(1));
+                builder.CreateStore(count, counterPtr);
+
+                auto hot = builder.CreateICmpEQ(count, builder.getInt64(threshold));
+                builder.SetInsertPoint(llvm::SplitBlockAndInsertIfThen(hot, point, false, weights));
+                builder.CreateCall(tierUpFn, {compiler, builder.getInt64(i)});
+            }
+        }
+    }
+
+    void TieredCompiler::redirectToStubs(llvm::Module &module) const {
+        for (auto &name: functions) {
+            auto fn = module.getFunction(name);
+            auto stub = llvm::Function::Create(fn->getFunctionType(), llvm::GlobalValue::ExternalLinkage, "", module);
+            stub->setAttributes(fn->getAttributes());
+
+            fn->replaceAllUsesWith(stub);
+            fn->setName(name + TIER0_SUFFIX);
+            stub->setName(name);
+        }
+    }
+
+    void TieredCompiler::run() {
+        while (true) {
+            int64_t index;
+
+            {
+                std::unique_lock lock(mutex);
+                cv.wait(lock, [&] { return stopped || !queue.empty(); });
+                if (stopped) {
+                    return;
+                }
+
+                index = queue.front();
+                queue.pop_front();
+                compiling++;
+            }
+
+            // the function keeps running its first tier
+            if (auto err = compile(index)) {
+                llvm::logAllUnhandledErrors(std::move(err), llvm::errs(), "couldn't recompile " + functions[index] + ": ");
+            }
+
+            {
+                std::lock_guard lock(mutex);
+                compiling--;
+            }
+            cv.notify_all();
+        }
+    }
+
+    llvm::Error TieredCompiler::compile(int64_t index) {
+        auto &name = functions[index];
+        llvm::LLVMContext context;
+
+        auto maybeModule = llvm::parseBitcodeFile(llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()), name), context);
+        if (!maybeModule) {
+            return maybeModule.takeError();
+        }
+        auto &module = **maybeModule;
+
+        // other functions are called through their stubs, their bodies are kept for inlining only
+        for (auto &fn: module) {
+            if (!fn.isDeclaration() && fn.getName() != name) {
+                fn.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+            }
+        }
+
+        // data is defined by the first tier
+        for (auto &var: module.globals()) {
+            if (!var.hasLocalLinkage()) {
+                var.setInitializer(nullptr);
+            }
+        }
+
+        module.getFunction(name)->setName(name + TIER1_SUFFIX);
+
+        Pipes::OptimizationTransform(mangler, gc, llvm::OptimizationLevel::O3).run(module);
+
+        auto TM = JTMB.createTargetMachine();
+        if (!TM) {
+            return TM.takeError();
+        }
+
+        auto object = llvm::orc::SimpleCompiler(**TM)(module);
+        if (!object) {
+            return object.takeError();
+        }
+
+        if (auto err = jitter.addObjectFile(std::move(*object))) {
+            return err;
+        }
+
+        auto body = jitter.lookup(name + TIER1_SUFFIX);
+        if (!body) {
+            return body.takeError();
+        }
+
+        // stub jumps through a pointer, which is an aligned machine word, so it's replaced by a single store
+        // and jitted code on other threads sees either the first or the second tier, both stay valid.
+        // the second tier is finalized (written and made executable) by lookup before the store
+        if (auto err = stubs->updatePointer(name, *body)) {
+            return err;
+        }
+
+        recompiledCount++;
+
+        return llvm::Error::success();
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/Module.h"
+
+#include "mangler.h"
+#include "gc/gc.h"
+
+namespace X {
+    // functions start in the tier compiled without optimizations, their calls and loop iterations are counted.
+    // hot functions are recompiled with O3 in background, then the stubs, which are called instead of the functions,
+    // are redirected to the new code
+    class TieredCompiler {
+        static inline const std::string TIER0_SUFFIX = ".tier0";
+        static inline const std::string TIER1_SUFFIX = ".tier1";
+
+        llvm::orc::LLJIT &jitter;
+        // target of the second tier
+        llvm::orc::JITTargetMachineBuilder JTMB;
+        std::shared_ptr<Mangler> mangler;
+        std::shared_ptr<GC::GC> gc;
+        uint64_t threshold;
+
+        std::unique_ptr<llvm::orc::IndirectStubsManager> stubs;
+        // unoptimized module, hot functions are compiled from it in their own contexts
+        llvm::SmallVector<char, 0> bitcode;
+        // counter index -> function name
+        std::vector<std::string> functions;
+
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<int64_t> queue;
+        // functions which are being compiled right now
+        std::size_t compiling = 0;
+        bool stopped = false;
+
+        std::atomic<std::size_t> recompiledCount = 0;
+
+    public:
+        TieredCompiler(llvm::orc::LLJIT &jitter, llvm::orc::JITTargetMachineBuilder JTMB, std::shared_ptr<Mangler> mangler,
+                       std::shared_ptr<GC::GC> gc, uint64_t threshold) :
+                jitter(jitter), JTMB(std::move(JTMB)), mangler(std::move(mangler)), gc(std::move(gc)), threshold(threshold) {
+            this->JTMB.setCodeGenOptLevel(llvm::CodeGenOptLevel::Aggressive);
+        }
+
+        // unfinished compilations are dropped
+        ~TieredCompiler();
+
+        // adds the first tier of the module to the jit
+        llvm::Error addModule(llvm::orc::ThreadSafeModule TSM);
+        // points stubs to the first tier and starts background compilation, must be called after every symbol is defined
+        llvm::Error start();
+
+        // blocks until every hot function is compiled
+        void wait();
+
+        // functions switched to the second tier
+        std::size_t getRecompiledCount() const { return recompiledCount; }
+
+        // called by jitted code when the function becomes hot
+        static void tierUp(TieredCompiler *compiler, int64_t index);
+
+    private:
+        // counts calls and loop iterations
+        void instrument(llvm::Module &module) const;
+        // calls go through stubs
+        void redirectToStubs(llvm::Module &module) const;
+
+        void run();
+        llvm::Error compile(int64_t index);
+    };
+}
@@ -12,8 +12,24 @@ namespace X {
         return llvm::ConstantInt::get(llvm::Type::getInt64Ty(module.getContext()), size);
     }
 
-    void die(const char *s) {
-        std::cout << s << std::endl;
-        std::exit(1);
+    void externalizeLocals(llvm::Module &module, const std::string &name) {
+        auto externalize = [&](llvm::GlobalValue &value) {
+            if (!value.hasName()) {
+                value.setName(name);
+            }
+            value.setLinkage(llvm::GlobalValue::ExternalLinkage);
+        };
+
+        for (auto &fn: module) {
+            if (fn.hasLocalLinkage()) {
+                externalize(fn);
+            }
+        }
+
+        for (auto &var: module.globals()) {
+            if (var.hasLocalLinkage() && !var.isConstant()) {
+                externalize(var);
+            }
+        }
     }
 }
@@ -10,5 +10,8 @@ namespace X {
     inline const std::string SELF_KEYWORD = "self";
 
     llvm::ConstantInt *getTypeSize(llvm::Module &module, llvm::Type *type);
-    void die(const char *s);
+
+    // gives external linkage to local functions and variables (constants are copied instead), so the module could be
+    // split into parts. unnamed values get the given name
+    void externalizeLocals(llvm::Module &module, const std::string &name);
 }
@@ -0,0 +1,75 @@
+#include <cstdio>
+#include <filesystem>
+
+#include "compiler_test_helper.h"
+
+class AotTest : public CompilerTest {
+protected:
+    std::filesystem::path buildDir = std::filesystem::temp_directory_path() / "x_aot_test";
+
+    AotTest() {
+        std::filesystem::remove_all(buildDir);
+        std::filesystem::create_directories(buildDir);
+    }
+
+    ~AotTest() override {
+        std::filesystem::remove_all(buildDir);
+    }
+
+    void checkExecutable(const std::string &code, const std::string &expectedOutput) {
+        auto executable = (buildDir / "program").string();
+        compiler.build(code, "program.x", executable);
+
+        auto pipe = popen(executable.c_str(), "r");
+        ASSERT_NE(pipe, nullptr);
+
+        std::string output;
+        char buf[256];
+        while (auto n = std::fread(buf, 1, sizeof(buf), pipe)) {
+            output.append(buf, n);
+        }
+        ASSERT_EQ(pclose(pipe), 0);
+
+        output.erase(output.find_last_not_of("\n") + 1);
+
+        ASSERT_EQ(output, expectedOutput);
+    }
+};
+
+TEST_F(AotTest, buildExecutable) {
+    checkExecutable(R"code(
+interface Named {
+    public fn name() string
+}
+
+class Node implements Named {
+    public int value
+
+    public fn name() string {
+        return "node" + "!"
+    }
+}
+
+fn main() void {
+    []Node nodes
+    []Named names
+    for i in range(100000) {
+        Node node = new Node()
+        node.value = i
+        nodes[] = node
+        if i < 3 {
+            names[] = node
+        }
+    }
+
+    int sum = 0
+    for node in nodes {
+        sum = sum + node.value
+    }
+
+    println(sum)
+    println(names.length())
+    println(names[2].name())
+}
+)code", "4999950000\n3\nnode!");
+}
@@ -0,0 +1,776 @@
+#include <algorithm>
+#include <sstream>
+
+#include "compiler_test_helper.h"
+
+class GCTest : public CompilerTest {
+protected:
+    // collect on every allocation
+    GCTest() {
+        compiler = Compiler({.threshold = 0, .heapGrowthFactor = 1});
+    }
+};
+
+TEST_F(GCTest, strings) {
+    checkCode(R"code(
+string s = ""
+for i in range(100) {
+    s = s + "a"
+}
+println(s.length())
+println(("hello" + " ") + ("world" + "!"))
+)code", "100\nhello world!");
+}
+
+TEST_F(GCTest, stringMethods) {
+    checkCode(R"code(
+string s = "  Hello World  "
+string res
+for i in range(20) {
+    res = (s.trim() + "!").toUpper().substring(6, 6) + s.toLower().trim().substring(0, 5)
+}
+println(res)
+println(res.contains("hello"))
+println(res.length())
+)code", "WORLD!hello\ntrue\n11");
+}
+
+TEST_F(GCTest, temporaries) {
+    checkProgram(R"code(
+class Foo {
+    public int a
+
+    public fn construct(int value) void {
+        a = value
+    }
+}
+
+fn f() Foo {
+    return new Foo(1)
+}
+
+fn g() Foo {
+    return new Foo(2)
+}
+
+fn h(Foo a, Foo b) int {
+    return a.a + b.a
+}
+
+fn main() void {
+    println(h(f(), g()))
+}
+)code", "3");
+}
+
+TEST_F(GCTest, objects) {
+    checkProgram(R"code(
+class Node {
+    public int value
+    public Node next
+    public []string tags = ["a", "b"]
+
+    public fn construct(int v) void {
+        value = v
+    }
+}
+
+fn main() void {
+    Node head = new Node(0)
+    for i in range(1, 10) {
+        Node node = new Node(i)
+        node.next = head
+        node.tags[] = "c"
+        head = node
+    }
+    println(head.value + head.next.value + head.next.next.value)
+    println(head.tags.length())
+}
+)code", "24\n3");
+}
+
+TEST_F(GCTest, arrays) {
+    checkProgram(R"code(
+class Foo {
+    public string name
+
+    public fn construct(string n) void {
+        name = n
+    }
+}
+
+fn main() void {
+    []Foo foos = [new Foo("a"), new Foo("b")]
+    for i in range(20) {
+        foos[] = new Foo("c")
+    }
+    println(foos.length())
+    println(foos[0].name + foos[1].name + foos[21].name)
+}
+)code", "22\nabc");
+}
+
+TEST_F(GCTest, interfaces) {
+    checkProgram(R"code(
+interface Named {
+    public fn getName() string
+}
+
+class Foo implements Named {
+    public fn getName() string {
+        return "foo" + "!"
+    }
+}
+
+fn greet(Named a, Named b) string {
+    return a.getName() + b.getName()
+}
+
+fn main() void {
+    println(greet(new Foo(), new Foo()))
+}
+)code", "foo!foo!");
+}
+
+TEST_F(GCTest, interfaceValues) {
+    checkProgram(R"code(
+interface Shape {
+    public fn area() int
+}
+
+class Square implements Shape {
+    public int side
+    public string name = "s"
+
+    public fn construct(int s) void {
+        side = s
+    }
+
+    public fn area() int {
+        return side * side
+    }
+}
+
+class Holder {
+    public Shape shape
+}
+
+fn make(int side) Shape {
+    return new Square(side)
+}
+
+fn area(Shape shape) int {
+    return shape.area()
+}
+
+fn main() void {
+    []Shape shapes
+    Holder holder = new Holder()
+    Shape last
+    for i in range(1, 30) {
+        shapes[] = make(i)
+        holder.shape = new Square(i + ("a" + "b").length())
+        last = shapes[i - 1]
+    }
+    int sum = 0
+    for shape in shapes {
+        sum = sum + area(shape)
+    }
+    println(sum)
+    println(holder.shape.area())
+    println(last.area())
+}
+)code", "8555\n961\n841");
+
+    // passing objects as interfaces doesn't allocate
+    compiler = Compiler();
+
+    checkProgram(R"code(
+interface Counter {
+    public fn get() int
+}
+
+class One implements Counter {
+    public fn get() int {
+        return 1
+    }
+}
+
+fn get(Counter counter) int {
+    return counter.get()
+}
+
+fn main() void {
+    One one = new One()
+    int sum = 0
+    for i in range(10000) {
+        sum = sum + get(one)
+    }
+    println(sum)
+}
+)code", "10000");
+
+    ASSERT_LT(compiler.getGCStats().allocatedBytes, 10000);
+}
+
+TEST_F(GCTest, subclasses) {
+    checkProgram(R"code(
+class Foo {
+    public string a = "a"
+
+    public fn get() string {
+        return a
+    }
+}
+
+class Bar extends Foo {
+    public string b = "b"
+    public []string c = ["c"]
+
+    public fn get() string {
+        return a + b + c[0]
+    }
+}
+
+fn make() Foo {
+    return new Bar()
+}
+
+fn main() void {
+    Foo foo = make()
+    for i in range(3) {
+        println(foo.get() + "!")
+    }
+}
+)code", "abc!\nabc!\nabc!");
+}
+
+TEST_F(GCTest, oldToYoung) {
+    checkProgram(R"code(
+class Box {
+    public string value
+
+    public fn set(string v) void {
+        value = v
+    }
+}
+
+fn main() void {
+    Box box = new Box()
+    []Box boxes = [box]
+    []string strings
+    for i in range(5) {
+        box.set("x" + "y")
+        box.value = box.value + "z"
+        strings[] = "s" + "t"
+        boxes[0] = new Box()
+        boxes[0].value = "q" + "w"
+    }
+    println(box.value)
+    println(strings[4])
+    println(boxes[0].value)
+}
+)code", "xyz\nst\nqw");
+}
+
+TEST_F(GCTest, parallelMark) {
+    // heap has to be big enough for marking threads to kick in
+    compiler = Compiler({.threshold = 8 * 1024 * 1024, .markThreads = 4});
+
+    checkProgram(R"code(
+class Node {
+    public Node left
+    public Node right
+    public string name
+
+    public fn construct(string n) void {
+        name = n
+    }
+}
+
+fn main() void {
+    []Node nodes
+    for i in range(100000) {
+        Node node = new Node("n" + "!")
+        if i > 0 {
+            node.left = nodes[i - 1]
+        }
+        nodes[] = node
+    }
+    for i in range(100000) {
+        nodes[i].right = new Node("r" + "?")
+    }
+    println(nodes.length())
+    println(nodes[99999].left.left.name + nodes[50000].right.name)
+}
+)code", "100000\nn!r?");
+}
+
+TEST_F(GCTest, stackMaps) {
+    compiler = Compiler({.threshold = 0, .heapGrowthFactor = 1, .stackMaps = true});
+
+    checkProgram(R"code(
+class Node {
+    public Node next
+    public string name
+
+    public fn construct(string n) void {
+        name = n
+    }
+}
+
+fn make(int n) Node {
+    Node head
+    for i in range(n) {
+        Node node = new Node("n" + "!")
+        node.next = head
+        head = node
+    }
+    return head
+}
+
+fn main() void {
+    Node a = make(10)
+    Node b = make(20)
+    string s = a.name + b.next.name
+    println(s.toUpper())
+}
+)code", "N!N!");
+}
+
+TEST_F(GCTest, tempRootsOfDifferentTypes) {
+    // slot of the string temp is released after the first statement, interface values must not reuse it
+    checkProgram(R"code(
+interface Shape {
+    public fn area() int
+}
+
+class Square implements Shape {
+    public int side
+
+    public fn construct(int s) void {
+        side = s
+    }
+
+    public fn area() int {
+        return side * side
+    }
+}
+
+fn make(int side) Shape {
+    return new Square(side)
+}
+
+fn main() void {
+    []Shape shapes
+    int total = 0
+    for i in range(1, 30) {
+        total = total + ("a" + "b").length()
+        shapes[] = make(i)
+        total = total + shapes[i - 1].area() + make(i).area()
+    }
+    println(total)
+    println(shapes.length())
+    println(shapes[28].area())
+}
+)code", "17168\n29\n841");
+}
+
+TEST_F(GCTest, stackAllocation) {
+    checkProgram(R"code(
+class Vec2 {
+    public int x
+    public int y
+
+    public fn construct(int x, int y) void {
+        this.x = x
+        this.y = y
+    }
+
+    public fn add(Vec2 other) Vec2 {
+        return new Vec2(x + other.x, y + other.y)
+    }
+}
+
+fn main() void {
+    int sum = 0
+    Vec2 prev = new Vec2(0, 0)
+    []Vec2 kept
+    for i in range(1000) {
+        Vec2 v = new Vec2(i, 2 * i)
+        sum = sum + v.x + v.y + prev.x
+        prev = v
+        if i % 100 == 0 {
+            kept[] = v.add(prev)
+        }
+    }
+    println(sum)
+    println(prev.x + prev.y)
+    println(kept.length())
+    println(kept[9].y)
+
+    int total = 0
+    for i in range(1000) {
+        Vec2 a = new Vec2(i, 1)
+        Vec2 d = a.add(new Vec2(1, i))
+        total = total + d.x * d.y
+    }
+    println(total)
+}
+)code", "1997001\n2997\n10\n3600\n333833500");
+
+    // objects which don't escape aren't allocated by gc
+    compiler = Compiler();
+
+    checkProgram(R"code(
+class Vec2 {
+    public int x
+    public int y
+
+    public fn construct(int x, int y) void {
+        this.x = x
+        this.y = y
+    }
+}
+
+fn main() void {
+    int sum = 0
+    for i in range(10000) {
+        Vec2 v = new Vec2(i, 2 * i)
+        sum = sum + v.x + v.y
+    }
+    println(sum)
+}
+)code", "149985000");
+
+    ASSERT_LT(compiler.getGCStats().allocatedBytes, 10000);
+
+    // objects which escape to the array are still allocated by gc
+    compiler = Compiler();
+
+    checkProgram(R"code(
+class Vec2 {
+    public int x
+    public int y
+
+    public fn construct(int x, int y) void {
+        this.x = x
+        this.y = y
+    }
+}
+
+fn main() void {
+    []Vec2 kept
+    for i in range(10000) {
+        Vec2 v = new Vec2(i, 2 * i)
+        kept[] = v
+    }
+    println(kept[9999].x + kept[9999].y)
+}
+)code", "29997");
+
+    ASSERT_GE(compiler.getGCStats().allocatedBytes, 10000 * 2 * sizeof(int64_t));
+}
+
+TEST_F(GCTest, stats) {
+    compiler = Compiler({.threshold = 256 * 1024, .nurserySize = 256 * 1024});
+
+    checkCode(R"code(
+[]string strings
+for i in range(10000) {
+    strings[] = "a" + "b"
+}
+println(strings.length())
+)code", "10000");
+
+    auto &stats = compiler.getGCStats();
+    ASSERT_GT(stats.collections, 0);
+    ASSERT_GT(stats.minorCollections, 0);
+    ASSERT_GT(stats.allocatedBytes, stats.liveBytes);
+    ASSERT_GT(stats.freedBytes, 0);
+    ASSERT_GE(stats.maxLiveBytes, stats.liveBytes);
+    ASSERT_GE(stats.heapBytes, stats.liveBytes);
+    ASSERT_GT(stats.peakRssBytes, 0);
+
+    std::stringstream json;
+    stats.toJSON(json);
+    ASSERT_TRUE(json.str().find("\"collections\": " + std::to_string(stats.collections)) != std::string::npos);
+}
+
+TEST_F(GCTest, heapLimit) {
+    compiler = Compiler({.threshold = 1024 * 1024, .maxHeapSize = 4 * 1024 * 1024});
+
+    // garbage is collected when the limit is reached
+    checkCode(R"code(
+string s
+for i in range(100000) {
+    s = "abcdefghijklmnopqrstuvwxyz" + "abcdefghijklmnopqrstuvwxyz"
+}
+println(s.length())
+)code", "52");
+
+    // live objects don't fit
+    ASSERT_EXIT(compiler.compile(R"code(
+fn main() void {
+    []string strings
+    for i in range(1000000) {
+        strings[] = "abcdefghijklmnopqrstuvwxyz" + "abcdefghijklmnopqrstuvwxyz"
+    }
+}
+)code"), testing::ExitedWithCode(1), "");
+}
+
+TEST_F(GCTest, largeArrays) {
+    compiler = Compiler({.threshold = 1024 * 1024});
+
+    checkCode(R"code(
+[]int a
+[]int b
+for i in range(1000000) {
+    a[] = i
+    b[] = 2 * i
+}
+int sum = 0
+for i in range(1000000) {
+    sum = sum + b[i] - a[i]
+}
+println(sum)
+)code", "499999500000");
+}
+
+TEST_F(GCTest, inlineArrays) {
+    compiler = Compiler({.threshold = 0, .heapGrowthFactor = 1, .nurserySize = 4096});
+
+    checkProgram(R"code(
+class Bag {
+    public []string items = ["a", "b"]
+    public []int counts = [1, 2, 3]
+}
+
+fn main() void {
+    []Bag bags
+    for i in range(50) {
+        Bag bag = new Bag()
+        for j in range(i % 12) {
+            bag.items[] = "x" + "y"
+            bag.counts[] = j
+        }
+        bags[] = bag
+    }
+    []string big = ["a", "b", "c", "d", "e", "f", "g", "h", "i", "j", "k", "l", "m", "n", "o", "p", "q", "r", "s", "t", "u", "v", "w", "x", "y", "z", "0", "1", "2", "3", "4", "5"]
+    big[] = "!"
+    println(bags[11].items.length())
+    println(bags[11].items[0] + bags[11].items[12])
+    println(bags[47].counts[13] + bags[5].counts[4])
+    println(big[0] + big[31] + big[32])
+}
+)code", "13\naxy\n11\na5!");
+}
+
+TEST_F(GCTest, census) {
+    compiler = Compiler({.threshold = 0, .heapGrowthFactor = 1, .census = true, .censusPathType = "Leaf"});
+
+    checkProgram(R"code(
+class Leaf {
+    public int value
+}
+
+class Tree {
+    public []Leaf leaves
+}
+
+fn main() void {
+    Tree tree = new Tree()
+    for i in range(100) {
+        tree.leaves[] = new Leaf()
+    }
+    // census is taken by the collection of this allocation, when all leaves are live
+    Tree other = new Tree()
+    println(tree.leaves.length() + other.leaves.length())
+}
+)code", "100");
+
+    auto &census = compiler.getGCCensus();
+    ASSERT_GT(census.liveBytes, 0);
+
+    auto leaves = std::ranges::find(census.entries, "Leaf", &X::GC::Census::Entry::name);
+    ASSERT_NE(leaves, census.entries.end());
+    ASSERT_EQ(leaves->count, 100);
+
+    // leaf could be also referenced by a temporary root
+    ASSERT_GE(census.retainingPath.size(), 2);
+    ASSERT_EQ(census.retainingPath.front(), "stack");
+    ASSERT_EQ(census.retainingPath.back(), "Leaf");
+}
+
+TEST_F(GCTest, censusStrings) {
+    compiler = Compiler({.threshold = 0, .heapGrowthFactor = 1, .census = true});
+
+    checkProgram(R"code(
+fn main() void {
+    []string names
+    for i in range(50) {
+        names[] = "name" + "!"
+    }
+    // census is taken by the collection of this allocation, when all names are live
+    []string other = ["last"]
+    println(names.length() + other.length())
+}
+)code", "51");
+
+    // strings aren't counted as raw memory
+    auto &census = compiler.getGCCensus();
+    auto strings = std::ranges::find(census.entries, "String", &X::GC::Census::Entry::name);
+    ASSERT_NE(strings, census.entries.end());
+    ASSERT_GE(strings->count, 50);
+}
+
+TEST_F(GCTest, allocationProfile) {
+    compiler = Compiler({.profileAllocations = true});
+
+    checkProgram(R"code(
+class Point {
+    public int x
+}
+
+fn main() void {
+    []Point points
+    for i in range(100) {
+        points[] = new Point()
+    }
+    println(points.length())
+}
+)code", "100");
+
+    auto sites = compiler.getGCStats().getTopAllocationSites(1);
+    ASSERT_EQ(sites.size(), 1);
+    // points and array data
+    ASSERT_EQ(sites[0].first, 9);
+    ASSERT_GE(sites[0].second.count, 100);
+}
+
+TEST_F(GCTest, reusedCells) {
+    compiler = Compiler({.threshold = 64 * 1024, .heapGrowthFactor = 1});
+
+    // cells of garbage are reused, new objects still have to start zeroed
+    checkProgram(R"code(
+class Item {
+    public int value
+    public string name
+    public []int values
+}
+
+fn main() void {
+    int dirty = 0
+    for i in range(10000) {
+        Item item = new Item()
+        if item.value != 0 || item.name.length() != 0 || item.values.length() != 0 {
+            dirty = dirty + 1
+        }
+        item.value = i + 1
+        item.name = "n" + "!"
+        item.values[] = i
+    }
+    string s
+    for i in range(1000) {
+        s = "abc" + "def"
+    }
+    println(dirty)
+    println(s)
+}
+)code", "0\nabcdef");
+}
+
+TEST_F(GCTest, inlineAllocation) {
+    // young objects are allocated by jitted code until the nursery is full
+    compiler = Compiler({.threshold = 4 * 1024 * 1024, .nurserySize = 1024 * 1024});
+
+    checkProgram(R"code(
+class Pair {
+    public int a
+    public Pair next
+
+    public fn construct(int a) void {
+        this.a = a
+    }
+}
+
+fn main() void {
+    Pair head
+    int sum = 0
+    for i in range(100000) {
+        Pair p = new Pair(i)
+        sum = sum + p.a
+        if i % 10 == 0 {
+            p.next = head
+            head = p
+        }
+    }
+    int count = 0
+    while head.a > 0 {
+        count = count + 1
+        head = head.next
+    }
+    println(sum)
+    println(count)
+}
+)code", "4999950000\n9999");
+
+    auto &stats = compiler.getGCStats();
+    ASSERT_GT(stats.minorCollections, 0);
+    ASSERT_GE(stats.allocatedBytes, 10000 * 16);
+}
+
+TEST_F(GCTest, compaction) {
+    compiler = Compiler({.threshold = 64 * 1024, .heapGrowthFactor = 1.1, .compact = true});
+
+    checkProgram(R"code(
+class Box {
+    public int value
+
+    public fn construct(int value) void {
+        this.value = value
+    }
+}
+
+class Item {
+    public int value
+    public Box box
+
+    public fn construct(int value) void {
+        this.value = value
+        this.box = new Box(value)
+    }
+}
+
+fn keep([]Item kept) void {
+    []Item items
+    for i in range(20000) {
+        items[] = new Item(i)
+    }
+    for i in range(20000) {
+        if i % 16 == 0 {
+            kept[] = items[i]
+        }
+    }
+}
+
+fn main() void {
+    []Item kept
+    keep(kept)
+    // pages of items are sparse now, replaced boxes make garbage for the next collections
+    for i in range(20000) {
+        Item item = kept[i % kept.length()]
+        item.box = new Box(item.value)
+    }
+    int sum = 0
+    for i in range(kept.length()) {
+        sum = sum + kept[i].value + kept[i].box.value
+    }
+    println(sum)
+}
+)code", "24980000");
+
+    auto &stats = compiler.getGCStats();
+    ASSERT_GT(stats.compactedBytes, 0);
+}
@@ -0,0 +1,65 @@
+#include "compiler_test_helper.h"
+
+class LazyJITTest : public CompilerTest {
+protected:
+    LazyJITTest() {
+        compiler = Compiler({}, "", {.lazy = true});
+    }
+};
+
+TEST_F(LazyJITTest, compileOnCall) {
+    checkProgram(R"code(
+interface Shape {
+    public fn area() int
+}
+
+class Square implements Shape {
+    public int side
+
+    public fn area() int {
+        return this.side * this.side
+    }
+}
+
+class Circle implements Shape {
+    public int r
+
+    public fn area() int {
+        return 3 * this.r * this.r
+    }
+}
+
+fn fib(int n) int {
+    if n < 2 {
+        return n
+    }
+    return fib(n - 1) + fib(n - 2)
+}
+
+// never called, so it's never compiled
+fn unused() void {
+    println("unused")
+}
+
+fn main() void {
+    []Shape shapes
+    for i in range(100) {
+        Square square = new Square()
+        square.side = i
+        shapes[] = square
+    }
+
+    int sum = 0
+    for shape in shapes {
+        sum = sum + shape.area()
+    }
+
+    println(sum)
+    println(fib(20))
+}
+)code", "328350\n6765");
+
+    auto &compiled = compiler.getJITStats().lazyCompiledFunctions;
+    ASSERT_TRUE(compiled.contains("fib"));
+    ASSERT_FALSE(compiled.contains("unused"));
+}
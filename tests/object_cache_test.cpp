@@ -0,0 +1,67 @@
+#include <filesystem>
+
+#include "compiler_test_helper.h"
+
+class ObjectCacheTest : public CompilerTest {
+protected:
+    std::filesystem::path cacheDir = std::filesystem::temp_directory_path() / "x_object_cache_test";
+
+    ObjectCacheTest() {
+        std::filesystem::remove_all(cacheDir);
+        compiler = Compiler({}, cacheDir);
+    }
+
+    ~ObjectCacheTest() override {
+        std::filesystem::remove_all(cacheDir);
+    }
+
+    std::size_t countObjects() const {
+        std::size_t count = 0;
+        for (auto &entry: std::filesystem::directory_iterator(cacheDir)) {
+            if (entry.path().extension() == ".o") {
+                count++;
+            }
+        }
+        return count;
+    }
+};
+
+TEST_F(ObjectCacheTest, reuseObject) {
+    auto code = R"code(
+class Node {
+    public int value
+    public Node next
+}
+
+fn main() void {
+    []Node nodes
+    for i in range(1000) {
+        Node node = new Node()
+        node.value = i
+        nodes[] = node
+    }
+    int sum = 0
+    for node in nodes {
+        sum = sum + node.value
+    }
+    println(sum)
+}
+)code";
+
+    checkProgram(code, "499500");
+    ASSERT_EQ(countObjects(), 1);
+    ASSERT_EQ(compiler.getJITStats().cacheHits, 0u);
+
+    // gc metas of the new run are linked to the cached object
+    checkProgram(code, "499500");
+    ASSERT_EQ(countObjects(), 1);
+    ASSERT_EQ(compiler.getJITStats().cacheHits, 1u);
+
+    checkProgram(R"code(
+fn main() void {
+    println("hello")
+}
+)code", "hello");
+    ASSERT_EQ(countObjects(), 2);
+    ASSERT_EQ(compiler.getJITStats().cacheHits, 0u);
+}
@@ -0,0 +1,52 @@
+#include "compiler_test_helper.h"
+
+class ParallelJITTest : public CompilerTest {
+protected:
+    ParallelJITTest() {
+        compiler = Compiler({}, "", {.compileThreads = 4});
+    }
+};
+
+TEST_F(ParallelJITTest, compileBigModule) {
+    // big enough to be split into parts, '_' in class names doesn't break grouping of methods
+    const int count = 200;
+    std::string code;
+    int64_t expected = 0;
+
+    for (auto i = 0; i < count; i++) {
+        auto index = std::to_string(i);
+        code += R"code(
+class Counter_)code" + index + R"code( {
+    public int value
+
+    public fn add(int n) void {
+        for j in range(n) {
+            this.value = this.value + j * )code" + index + R"code(
+        }
+    }
+}
+
+fn count)code" + index + R"code((int n) int {
+    Counter_)code" + index + R"code( counter = new Counter_)code" + index + R"code(()
+    counter.add(n)
+    return counter.value
+}
+)code";
+        expected += 45 * i;
+    }
+
+    code += R"code(
+fn main() void {
+    int sum = 0
+)code";
+    for (auto i = 0; i < count; i++) {
+        code += "    sum = sum + count" + std::to_string(i) + "(10)\n";
+    }
+    code += R"code(    println(sum)
+}
+)code";
+
+    checkProgram(code, std::to_string(expected));
+
+    ASSERT_GT(compiler.getJITStats().moduleParts, 1u);
+}
@@ -0,0 +1,79 @@
+#include "compiler_test_helper.h"
+
+class TieredJITTest : public CompilerTest {
+protected:
+    TieredJITTest() {
+        compiler = Compiler({}, "", {.tiered = true, .tierUpThreshold = 100});
+    }
+};
+
+TEST_F(TieredJITTest, recompileHotFunctions) {
+    checkProgram(R"code(
+class Counter {
+    public int value
+
+    public fn add(int n) void {
+        this.value = this.value + n
+    }
+}
+
+fn sum(int n) int {
+    int res = 0
+    for i in range(n) {
+        res = res + i
+    }
+    return res
+}
+
+fn fib(int n) int {
+    if n < 2 {
+        return n
+    }
+    return fib(n - 1) + fib(n - 2)
+}
+
+fn main() void {
+    // calls switch to the second tier while the program runs
+    Counter counter = new Counter()
+    int total = 0
+    for i in range(20000) {
+        counter.add(1)
+        total = total + sum(100)
+    }
+
+    println(counter.value)
+    println(total)
+    println(fib(25))
+}
+)code", "20000\n99000000\n75025");
+}
+
+TEST_F(TieredJITTest, countRecompiledFunctions) {
+    checkProgram(R"code(
+fn sum(int n) int {
+    int res = 0
+    for i in range(n) {
+        res = res + i
+    }
+    return res
+}
+
+fn once() int {
+    return 1
+}
+
+fn main() void {
+    []int values
+    int total = once()
+    for i in range(1000) {
+        values[] = i
+        total = total + sum(10)
+    }
+    println(total)
+    println(values.length())
+}
+)code", "45001\n1000");
+
+    // array methods are internal, once isn't hot, so only sum gets the second tier
+    ASSERT_EQ(compiler.getJITStats().recompiledFunctions, 1u);
+}